@@ -5,6 +5,7 @@
 
 #include "SDL_xboxaudio.h"
 #include "SDL_internal.h"
+#include "contiguous_heap.h"
 
 #include <hal/audio.h>
 #include <assert.h>
@@ -65,14 +66,11 @@ static bool XBOXAUDIO_OpenDevice(SDL_AudioDevice *device)
     audio_data->buffer_size = SDL_GetDefaultSampleFramesFromFreq(device->spec.freq) * SDL_AUDIO_FRAMESIZE(device->spec);
 
     for (int i = 0; i < SDL_XBOXAUDIO_BUFFER_COUNT; i++) {
-        audio_data->buffers[i] = MmAllocateContiguousMemoryEx(audio_data->buffer_size, 0, 0xFFFFFFFF,
-                                                              0, PAGE_READWRITE | PAGE_WRITECOMBINE);
+        audio_data->buffers[i] = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, audio_data->buffer_size);
         if (audio_data->buffers[i] == NULL) {
             SDL_SetError("Failed to allocate audio buffer");
             for (int j = 0; j < i; j++) {
-                if (audio_data->buffers[j]) {
-                    MmFreeContiguousMemory(audio_data->buffers[j]);
-                }
+                contiguous_heap_free(audio_data->buffers[j]);
             }
             SDL_free(audio_data);
             return false;
@@ -94,9 +92,7 @@ static void XBOXAUDIO_CloseDevice(SDL_AudioDevice *device)
     XAudioInit(16, 2, NULL, NULL);
 
     for (int i = 0; i < SDL_XBOXAUDIO_BUFFER_COUNT; i++) {
-        if (audio_data->buffers[i]) {
-            MmFreeContiguousMemory(audio_data->buffers[i]);
-        }
+        contiguous_heap_free(audio_data->buffers[i]);
     }
 
     SDL_free(audio_data);
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#include "contiguous_heap.h"
+
+#include <SDL3/SDL.h>
+#include <stdint.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+// Allocations above this size go straight to MmAllocateContiguousMemoryEx. Page rounding wastes at
+// most a few percent of these, while the buddy allocator would round them up to a power of two.
+#ifndef SDL_XBOX_HEAP_DIRECT_THRESHOLD
+#define SDL_XBOX_HEAP_DIRECT_THRESHOLD (64 * 1024)
+#endif
+
+#define HEAP_MIN_SHIFT   7  // 128 byte smallest chunk
+#define HEAP_BLOCK_SHIFT 18 // 256 KB blocks
+#define HEAP_BLOCK_SIZE  (1 << HEAP_BLOCK_SHIFT)
+#define HEAP_ORDER_COUNT (HEAP_BLOCK_SHIFT - HEAP_MIN_SHIFT + 1)
+#define HEAP_UNITS       (1 << (HEAP_BLOCK_SHIFT - HEAP_MIN_SHIFT))
+
+#if (SDL_XBOX_HEAP_DIRECT_THRESHOLD > HEAP_BLOCK_SIZE)
+#error "SDL_XBOX_HEAP_DIRECT_THRESHOLD must not be larger than the heap block size"
+#endif
+
+// The bookkeeping is kept in cached system memory, reading it back from write-combined memory would be slow.
+typedef struct heap_block
+{
+    struct heap_block *next;
+    uint8_t *base;
+    // One bit per chunk of every order, set if the chunk is free. Order k starts at order_bit_offset(k).
+    uint32_t free_bits[(2 * HEAP_UNITS) / 32];
+    uint16_t free_count[HEAP_ORDER_COUNT];
+    // Order + 1 of the allocation that starts at each unit, 0 if no allocation starts there
+    uint8_t alloc_order[HEAP_UNITS];
+} heap_block_t;
+
+typedef struct heap_direct
+{
+    struct heap_direct *next;
+    void *ptr;
+    size_t size;
+} heap_direct_t;
+
+typedef struct heap_pool
+{
+    ULONG protect;
+    heap_block_t *blocks;
+    heap_direct_t *direct;
+    size_t bytes_in_use;
+    size_t bytes_reserved;
+    size_t peak_bytes_in_use;
+} heap_pool_t;
+
+static heap_pool_t pools[CONTIGUOUS_HEAP_POOL_COUNT] = {
+    [CONTIGUOUS_HEAP_WRITECOMBINE] = { .protect = PAGE_READWRITE | PAGE_WRITECOMBINE },
+    [CONTIGUOUS_HEAP_CACHED] = { .protect = PAGE_READWRITE },
+};
+
+// Audio and the renderer may allocate from different threads
+static SDL_SpinLock heap_lock;
+
+static inline unsigned int order_bit_offset(int order)
+{
+    return 2 * HEAP_UNITS - 2 * (HEAP_UNITS >> order);
+}
+
+static inline bool is_free(const heap_block_t *block, int order, unsigned int index)
+{
+    const unsigned int bit = order_bit_offset(order) + index;
+    return (block->free_bits[bit / 32] >> (bit % 32)) & 1;
+}
+
+static inline void set_free(heap_block_t *block, int order, unsigned int index, bool free)
+{
+    const unsigned int bit = order_bit_offset(order) + index;
+    if (free) {
+        block->free_bits[bit / 32] |= 1U << (bit % 32);
+        block->free_count[order]++;
+    } else {
+        block->free_bits[bit / 32] &= ~(1U << (bit % 32));
+        block->free_count[order]--;
+    }
+}
+
+static int size_to_order(size_t size)
+{
+    int order = 0;
+    while (((size_t)1 << (order + HEAP_MIN_SHIFT)) < size) {
+        order++;
+    }
+    return order;
+}
+
+static void update_peak(heap_pool_t *pool)
+{
+    if (pool->bytes_in_use > pool->peak_bytes_in_use) {
+        pool->peak_bytes_in_use = pool->bytes_in_use;
+    }
+}
+
+static heap_block_t *block_create(heap_pool_t *pool)
+{
+    heap_block_t *block = SDL_calloc(1, sizeof(heap_block_t));
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->base = MmAllocateContiguousMemoryEx(HEAP_BLOCK_SIZE, 0, 0xFFFFFFFF, 0, pool->protect);
+    if (block->base == NULL) {
+        SDL_free(block);
+        return NULL;
+    }
+
+    // The whole block starts as one free chunk of the highest order
+    set_free(block, HEAP_ORDER_COUNT - 1, 0, true);
+
+    block->next = pool->blocks;
+    pool->blocks = block;
+    pool->bytes_reserved += HEAP_BLOCK_SIZE;
+    return block;
+}
+
+static void *block_alloc(heap_block_t *block, int order)
+{
+    // Find the smallest free chunk that fits, then split it down to the requested order
+    int k;
+    unsigned int index = 0;
+    for (k = order; k < HEAP_ORDER_COUNT; k++) {
+        if (block->free_count[k] == 0) {
+            continue;
+        }
+        while (!is_free(block, k, index)) {
+            index++;
+        }
+        break;
+    }
+    if (k == HEAP_ORDER_COUNT) {
+        return NULL;
+    }
+
+    set_free(block, k, index, false);
+    while (k > order) {
+        k--;
+        index *= 2;
+        set_free(block, k, index + 1, true);
+    }
+
+    const unsigned int unit = index << order;
+    block->alloc_order[unit] = (uint8_t)(order + 1);
+    return block->base + (unit << HEAP_MIN_SHIFT);
+}
+
+// Returns the size of the freed chunk
+static size_t block_free(heap_block_t *block, void *ptr)
+{
+    const unsigned int unit = (unsigned int)((uint8_t *)ptr - block->base) >> HEAP_MIN_SHIFT;
+    int order = block->alloc_order[unit] - 1;
+    const size_t size = (size_t)1 << (order + HEAP_MIN_SHIFT);
+    block->alloc_order[unit] = 0;
+
+    // Merge with the buddy chunk for as long as it is also free
+    unsigned int index = unit >> order;
+    while (order < HEAP_ORDER_COUNT - 1 && is_free(block, order, index ^ 1)) {
+        set_free(block, order, index ^ 1, false);
+        index >>= 1;
+        order++;
+    }
+    set_free(block, order, index, true);
+    return size;
+}
+
+static void *pool_alloc_direct(heap_pool_t *pool, size_t size)
+{
+    heap_direct_t *direct = SDL_malloc(sizeof(heap_direct_t));
+    if (direct == NULL) {
+        return NULL;
+    }
+
+    direct->ptr = MmAllocateContiguousMemoryEx(size, 0, 0xFFFFFFFF, 0, pool->protect);
+    if (direct->ptr == NULL) {
+        SDL_free(direct);
+        return NULL;
+    }
+
+    direct->size = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    direct->next = pool->direct;
+    pool->direct = direct;
+    pool->bytes_in_use += direct->size;
+    pool->bytes_reserved += direct->size;
+    update_peak(pool);
+    return direct->ptr;
+}
+
+void *contiguous_heap_alloc(contiguous_heap_pool_t pool_type, size_t size)
+{
+    heap_pool_t *pool = &pools[pool_type];
+    void *ptr = NULL;
+
+    if (size == 0) {
+        return NULL;
+    }
+
+    SDL_LockSpinlock(&heap_lock);
+    if (size > SDL_XBOX_HEAP_DIRECT_THRESHOLD) {
+        ptr = pool_alloc_direct(pool, size);
+    } else {
+        const int order = size_to_order(size);
+        for (heap_block_t *block = pool->blocks; block != NULL && ptr == NULL; block = block->next) {
+            ptr = block_alloc(block, order);
+        }
+
+        if (ptr == NULL) {
+            heap_block_t *block = block_create(pool);
+            ptr = (block) ? block_alloc(block, order) : NULL;
+        }
+
+        if (ptr) {
+            pool->bytes_in_use += (size_t)1 << (order + HEAP_MIN_SHIFT);
+            update_peak(pool);
+        }
+    }
+    SDL_UnlockSpinlock(&heap_lock);
+
+    return ptr;
+}
+
+void contiguous_heap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    SDL_LockSpinlock(&heap_lock);
+    for (int i = 0; i < CONTIGUOUS_HEAP_POOL_COUNT; i++) {
+        heap_pool_t *pool = &pools[i];
+
+        for (heap_block_t **link = &pool->blocks; *link != NULL; link = &(*link)->next) {
+            heap_block_t *block = *link;
+            if ((uint8_t *)ptr < block->base || (uint8_t *)ptr >= block->base + HEAP_BLOCK_SIZE) {
+                continue;
+            }
+
+            pool->bytes_in_use -= block_free(block, ptr);
+
+            // Give empty blocks back to the kernel so other contiguous allocations can use them
+            if (block->free_count[HEAP_ORDER_COUNT - 1] == 1) {
+                *link = block->next;
+                MmFreeContiguousMemory(block->base);
+                SDL_free(block);
+                pool->bytes_reserved -= HEAP_BLOCK_SIZE;
+            }
+            SDL_UnlockSpinlock(&heap_lock);
+            return;
+        }
+
+        for (heap_direct_t **link = &pool->direct; *link != NULL; link = &(*link)->next) {
+            heap_direct_t *direct = *link;
+            if (direct->ptr != ptr) {
+                continue;
+            }
+
+            *link = direct->next;
+            MmFreeContiguousMemory(direct->ptr);
+            pool->bytes_in_use -= direct->size;
+            pool->bytes_reserved -= direct->size;
+            SDL_free(direct);
+            SDL_UnlockSpinlock(&heap_lock);
+            return;
+        }
+    }
+    SDL_UnlockSpinlock(&heap_lock);
+
+    SDL_assert(!"contiguous_heap_free: pointer was not allocated from the heap");
+}
+
+void contiguous_heap_get_stats(contiguous_heap_pool_t pool_type, contiguous_heap_stats_t *stats)
+{
+    const heap_pool_t *pool = &pools[pool_type];
+    size_t free_bytes = 0;
+    size_t largest_free = 0;
+
+    SDL_LockSpinlock(&heap_lock);
+    for (const heap_block_t *block = pool->blocks; block != NULL; block = block->next) {
+        for (int order = 0; order < HEAP_ORDER_COUNT; order++) {
+            const size_t chunk_size = (size_t)1 << (order + HEAP_MIN_SHIFT);
+            free_bytes += block->free_count[order] * chunk_size;
+            if (block->free_count[order] && chunk_size > largest_free) {
+                largest_free = chunk_size;
+            }
+        }
+    }
+
+    stats->bytes_in_use = pool->bytes_in_use;
+    stats->bytes_reserved = pool->bytes_reserved;
+    stats->peak_bytes_in_use = pool->peak_bytes_in_use;
+    stats->fragmentation = (free_bytes) ? (unsigned int)(100 - (largest_free * 100) / free_bytes) : 0;
+    SDL_UnlockSpinlock(&heap_lock);
+}
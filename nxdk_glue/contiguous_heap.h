@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#ifndef CONTIGUOUS_HEAP_H
+#define CONTIGUOUS_HEAP_H
+
+#include <stddef.h>
+
+// Shared heap of physically contiguous memory for the renderer, audio and video glue.
+// Small allocations are sub-allocated from large blocks with a buddy allocator so they are not each
+// rounded up to whole pages, and so long sessions do not fragment physical memory. Allocations larger
+// than SDL_XBOX_HEAP_DIRECT_THRESHOLD are passed straight to the kernel.
+// All allocations are aligned to at least 128 bytes which is sufficient for NV2A textures.
+
+typedef enum contiguous_heap_pool
+{
+    CONTIGUOUS_HEAP_WRITECOMBINE, // Memory written by the CPU and read by the GPU or audio hardware
+    CONTIGUOUS_HEAP_CACHED,       // Memory the CPU also reads back
+    CONTIGUOUS_HEAP_POOL_COUNT
+} contiguous_heap_pool_t;
+
+typedef struct contiguous_heap_stats
+{
+    size_t bytes_in_use;        // Bytes handed out, including the rounding of each allocation
+    size_t bytes_reserved;      // Bytes allocated from the kernel
+    size_t peak_bytes_in_use;   // Highest bytes_in_use seen
+    unsigned int fragmentation; // Percentage of free block memory outside the largest free chunk
+} contiguous_heap_stats_t;
+
+// Returns NULL if the allocation fails. The memory is not cleared.
+void *contiguous_heap_alloc(contiguous_heap_pool_t pool, size_t size);
+
+// Frees memory from contiguous_heap_alloc. ptr may be NULL.
+void contiguous_heap_free(void *ptr);
+
+void contiguous_heap_get_stats(contiguous_heap_pool_t pool, contiguous_heap_stats_t *stats);
+
+#endif
@@ -5,7 +5,12 @@
 
 #ifdef SDL_VIDEO_RENDER_XGU
 
+#include "SDL_render_xgu.h"
+#include "contiguous_heap.h"
+#include "state_shadow.h"
 #include "swizzle.h"
+#include "vertex_pack.h"
+#include "xgu_capture.h"
 #include "xgu/xgux.h"
 #include <../src/render/SDL_sysrender.h>
 #include <SDL3/SDL_pixels.h>
@@ -14,31 +19,157 @@
 
 #define nxdk_RenderDriver GPU_RenderDriver
 
-// Note: To avoid stalls this vertex buffer must be sufficient to
-// hold three frames (pbkit is tripple buffered) worth of vertices. This is to allow for
-// both the back buffers being rendered, and the active front buffer being calculated.
-#ifndef SDL_XGU_VERTEX_BUFFER_SIZE
-#define SDL_XGU_VERTEX_BUFFER_SIZE (512 * 1024)
+// Vertices are written to a chain of contiguous chunks of this size. A chunk is reused once the GPU has
+// finished every frame that used it, and the arena grows by another chunk when all of them are in flight.
+#ifndef SDL_XGU_VERTEX_CHUNK_SIZE
+#define SDL_XGU_VERTEX_CHUNK_SIZE (128 * 1024)
+#endif
+
+// Chunks that have not been used for this many frames are freed
+#ifndef SDL_XGU_VERTEX_SHRINK_FRAMES
+#define SDL_XGU_VERTEX_SHRINK_FRAMES 120
 #endif
 
 #ifndef SDL_XGU_VERTEX_ALIGNMENT
 #define SDL_XGU_VERTEX_ALIGNMENT 32
 #endif
 
+// Draws with at most this many bytes of vertices are pushed inline with NV097_INLINE_ARRAY instead of being
+// fetched from the vertex arena. For a single quad or a few points this is cheaper than setting up the arrays.
+// 0 disables inline vertices.
+#ifndef SDL_XGU_INLINE_VERTEX_SIZE
+#define SDL_XGU_INLINE_VERTEX_SIZE 128
+#endif
+
+// Bundle vertices are allocated in chunks of this size
+#ifndef SDL_XGU_BUNDLE_VERTEX_CHUNK_SIZE
+#define SDL_XGU_BUNDLE_VERTEX_CHUNK_SIZE (16 * 1024)
+#endif
+
+// System memory that holds inline vertices from when they are queued until the command queue is run
+#ifndef SDL_XGU_INLINE_BUFFER_SIZE
+#define SDL_XGU_INLINE_BUFFER_SIZE (16 * 1024)
+#endif
+
+// Side length in pixels of the swizzled pages that small static textures share when the texture atlas is enabled
+#ifndef SDL_XGU_ATLAS_PAGE_SIZE
+#define SDL_XGU_ATLAS_PAGE_SIZE 256
+#endif
+
+// Static textures are only put into the atlas if neither side is larger than this
+#ifndef SDL_XGU_ATLAS_MAX_TEXTURE_SIZE
+#define SDL_XGU_ATLAS_MAX_TEXTURE_SIZE 64
+#endif
+
+// Every texture in the atlas is surrounded by a copy of its edge pixels, so linear filtering at its edges never
+// samples its neighbours
+#define SDL_XGU_ATLAS_GUTTER 1
+
+// Shelf heights in the atlas are rounded up to a multiple of this so textures of similar heights share shelves
+#define SDL_XGU_ATLAS_SHELF_ALIGN 8
+
+// INDEX8 textures always use a full size palette of A8R8G8B8 entries
+#define SDL_XGU_PALETTE_ENTRIES 256
+
+// Extra GPU copies of a palette that have not been drawn with for this many frames are freed
+#ifndef SDL_XGU_PALETTE_SHRINK_FRAMES
+#define SDL_XGU_PALETTE_SHRINK_FRAMES 120
+#endif
+
+// Y plane pitch of planar YUV textures. The chroma planes follow the Y plane at half this pitch, so every
+// plane starts at a multiple of 128 bytes.
+#define SDL_XGU_YUV_PITCH_ALIGN 256
+
+// Register combiner stages that convert planar YUV to RGB
+#define SDL_XGU_YUV_COMBINER_STAGES 5
+
+// Use 16-bit integer positions and texture coordinates for geometry that is pixel aligned
+#ifndef SDL_XGU_COMPACT_VERTICES
+#define SDL_XGU_COMPACT_VERTICES 1
+#endif
+
 #ifndef SDL_XGU_SHOW_FPS
 #define SDL_XGU_SHOW_FPS 0
 #endif
 
+// Draws the per-frame statistics and a graph of recent frame times over the rendered image
+#ifndef SDL_XGU_SHOW_STATS
+#define SDL_XGU_SHOW_STATS 0
+#endif
+
+// Number of frames graphed by SDL_XGU_SHOW_STATS
+#define SDL_XGU_STATS_HISTORY 64
+
 // Xbox GPU defines pixel centers at integer coordinates: (0,0)
 // We offset by half a pixel so that (0,0) is exactly the top-left corner of the pixel for lines and dots
 #define SDL_XGU_PIXEL_BIAS (0.5f)
 
 #define SDL_XGU_MAYBE_UNUSED __attribute__((unused))
 
+// Element arrays are pushed in batches of this many dwords to keep each pb_begin/pb_end block small.
+#define SDL_XGU_ELEMENT_BATCH 120
+
+// pbkit only guarantees room for this many dwords between pb_begin and pb_end
+#define SDL_XGU_PUSH_BLOCK_SIZE 128
+
+// Size in dwords of the system memory buffers register state is built in before it is checked against the shadow
+#define SDL_XGU_STATE_BATCH 32
+
 // pbkit does not provide a way to see how many buffers are available, however it is currently
 // hardcoded to 3 buffers.
 #define SDL_XGU_BUFFER_COUNT 3
 
+// RenderPresent returns as soon as the frame is queued, and only waits for the GPU once this many frames
+// are queued but not yet rendered. One buffer is always being displayed so this can be at most SDL_XGU_BUFFER_COUNT - 1.
+// This is the default and the maximum, SDL_PROP_RENDERER_CREATE_XGU_FRAMES_IN_FLIGHT_NUMBER can lower it.
+#define SDL_XGU_MAX_FRAMES_IN_FLIGHT (SDL_XGU_BUFFER_COUNT - 1)
+
+// Streaming textures get up to this many backing buffers, so they can be updated every frame without
+// writing over data the GPU is still reading for a frame in flight. The extra buffers are only
+// allocated once a texture is updated while its current buffer is in use.
+#ifndef SDL_XGU_STREAMING_BUFFER_COUNT
+#define SDL_XGU_STREAMING_BUFFER_COUNT SDL_XGU_BUFFER_COUNT
+#endif
+
+#if (SDL_XGU_STREAMING_BUFFER_COUNT < 1)
+#error "SDL_XGU_STREAMING_BUFFER_COUNT must be at least 1"
+#endif
+
+// Render targets are bound through a pool of DMA contexts, so switching between a few targets does not rebind
+// a context, and rebinding the least recently used one rarely has to wait for the GPU. Each context needs a
+// DMA channel that pbkit doesn't use, see render_target_dma_channels in XBOX_CreateRenderer.
+#define SDL_XGU_RENDER_TARGET_DMA_CONTEXTS 4
+
+typedef struct xgu_texture_buffer
+{
+    uint8_t *data;
+    uint8_t *physical_address;
+    uint32_t last_used_frame; // 0 if it has never been drawn
+} xgu_texture_buffer_t;
+
+// A row of the atlas. Textures are placed left to right and their space is only reclaimed with the whole page.
+typedef struct xgu_atlas_shelf
+{
+    int y;
+    int height;
+    int used_width;
+} xgu_atlas_shelf_t;
+
+// A swizzled texture that small static textures of one format are packed into
+typedef struct xgu_atlas_page
+{
+    struct xgu_atlas_page *next;
+    uint8_t *data;
+    uint8_t *physical_address;
+    XguTexFormatColor format;
+    int bytes_per_pixel;
+    int texture_count;
+    uint32_t last_used_frame; // Last frame that drew any texture on the page, 0 if none did
+    int used_height;
+    int shelf_count;
+    xgu_atlas_shelf_t shelves[SDL_XGU_ATLAS_PAGE_SIZE / SDL_XGU_ATLAS_SHELF_ALIGN];
+} xgu_atlas_page_t;
+
 typedef struct xgu_texture
 {
     int data_width;
@@ -50,59 +181,225 @@ typedef struct xgu_texture
     int swizzled;
     float u_scale;
     float v_scale;
+    float u_offset;
+    float v_offset;
     XguTexFormatColor format;
-    XguTexFilter filter;
-    XguTextureAddress mode_u;
-    XguTextureAddress mode_v;
     uint8_t *data;
     uint8_t *data_physical_address;
+    int streaming;
+    int buffer_index;
+    xgu_texture_buffer_t buffers[SDL_XGU_STREAMING_BUFFER_COUNT];
+    xgu_atlas_page_t *atlas_page; // NULL unless the texture is stored in the atlas, at atlas_x, atlas_y
+    int atlas_x;
+    int atlas_y;
+    int block_size;         // Bytes per 4x4 block of a DXT compressed texture, 0 for uncompressed textures
+    size_t compressed_saving; // Bytes saved compared to the same texture stored as 32-bit pixels
+    xgu_texture_buffer_t *palettes; // GPU copies of the palette of an INDEX8 texture, NULL for other textures
+    size_t palette_count;
+    size_t palette_capacity;
+    int palette_index; // Copy holding the palette that draws queued now read
+    const SDL_Palette *palette_source; // SDL palette and version the current GPU copy was made from
+    Uint32 palette_version;
+    size_t buffer_size; // Bytes in each of buffers
+    int planes;         // 2 for NV12 and NV21, 3 for IYUV and YV12, otherwise 1
+    size_t chroma_offsets[2]; // Offsets in data of the U and V planes, or of the interleaved UV plane
+    int chroma_pitch;
+    uint32_t combiner_factors[SDL_XGU_YUV_COMBINER_STAGES][2]; // Constants for the YUV to RGB combiner stages
 } xgu_texture_t;
 
+// A render target DMA context and the memory it currently covers
+typedef struct xgu_render_target_dma
+{
+    struct s_CtxDma ctx;
+    const uint8_t *data; // NULL until the context is first bound
+    uint32_t limit;
+    uint32_t last_used_frame; // Last frame that rendered through the context, 0 if none did
+} xgu_render_target_dma_t;
+
+typedef struct xgu_arena_chunk
+{
+    struct xgu_arena_chunk *next;
+    uint8_t *data;
+    size_t size;
+    uint32_t last_used_frame;
+} xgu_arena_chunk_t;
+
 typedef struct xgu_point
 {
     float pos[2]; // xy
 } xgu_point_t;
 
-typedef struct xgu_vertex
+// An SDL_XGU_RenderReadPixelsAsync request waiting for its frame to finish
+typedef struct xgu_readback
 {
-    float pos[2];     // xy
-    uint8_t color[4]; // rgba8888
-} xgu_vertex_t;
+    SDL_Rect rect;
+    const xgu_texture_t *source;  // NULL for the back buffer
+    const uint8_t *back_buffer;   // The back buffer of the frame the readback was queued in
+    uint32_t frame;
+    SDL_PixelFormat format;
+    SDL_XGU_ReadPixelsCallback callback;
+    void *userdata;
+} xgu_readback_t;
+
+// Kinds of register state counted in the statistics
+enum xgu_state_type
+{
+    XGU_STATE_BLEND,
+    XGU_STATE_SHADER,
+    XGU_STATE_TEXTURE,
+    XGU_STATE_VIEWPORT,
+    XGU_STATE_COLOR,
+    XGU_STATE_VERTEX_ARRAY,
+    XGU_STATE_TYPE_COUNT,
+};
+
+// Counters for the frame being rendered, published as renderer properties by SDL_RenderPresent
+typedef struct xgu_frame_stats
+{
+    int draw_calls;
+    int merged_draws;
+    int state_changes[XGU_STATE_TYPE_COUNT]; // Methods pushed for each kind of state
+    size_t vertex_bytes;
+    size_t pushbuffer_bytes;
+    int texture_uploads;
+    int palette_uploads;
+    size_t swizzled_bytes;
+    Uint64 command_queue_ns;
+} xgu_frame_stats_t;
+
+// A texture buffer and palette copy drawn by a bundle, marked as used each time the bundle is drawn
+typedef struct xgu_bundle_texture
+{
+    xgu_texture_t *texture;
+    int buffer_index;
+    int palette_index;
+} xgu_bundle_texture_t;
 
-typedef struct xgu_vertex_texture
+// Pushbuffer methods recorded between SDL_XGU_BeginBundle and SDL_XGU_EndBundle, and the vertices they draw
+struct SDL_XGU_Bundle
 {
-    float pos[2];     // xy
-    uint8_t color[4]; // rgba8888
-    float tex[2];     // uv
-} xgu_vertex_textured_t;
+    SDL_Renderer *renderer;
+    SDL_XGU_Bundle *next; // Next bundle of the renderer
+    uint32_t *commands;
+    size_t command_count;
+    size_t command_capacity;
+    size_t *viewport_patches; // Index in commands of the x offset of every NV097_SET_VIEWPORT_OFFSET
+    size_t viewport_patch_count;
+    size_t viewport_patch_capacity;
+    xgu_bundle_texture_t *textures;
+    size_t texture_count;
+    size_t texture_capacity;
+    xgu_arena_chunk_t *vertex_chunks;
+    size_t vertex_offset;
+    uint32_t last_used_frame;
+    bool failed; // Out of memory while recording
+    bool cleared; // SDL_RenderClear was called while recording
+    bool detached; // A texture the bundle draws was destroyed
+};
 
 typedef struct xgu_render_data
 {
-    int texture_shader_active;
-    const xgu_texture_t *active_texture;
+    xgu_state_shadow_t state;
     const xgu_texture_t *active_render_target;
     SDL_Rect viewport;
     SDL_Rect clip_rect;
-    SDL_BlendMode active_blend_mode;
-    void *vertex_data;
-    int vertex_arena_offset;
-    int vertex_allocations[SDL_XGU_BUFFER_COUNT];
-    int frame_index;
-    struct s_CtxDma render_target_dma_ctx;
+    xgu_arena_chunk_t *arena_chunks;
+    xgu_arena_chunk_t *arena_current;
+    size_t arena_offset;
+    size_t arena_size;
+    size_t arena_high_water;
+    int max_frames_in_flight;
+    uint32_t frame_serial;
+    volatile uint32_t *fence; // Serial of the last frame the GPU has finished
+    Uint64 present_wait_ns;
+    Uint64 refresh_period_ns;
+    Uint64 last_vblank_ns;
+    uint32_t vbl_counter; // pbkit's vblank counter at last_vblank_ns
+    xgu_frame_stats_t stats;
+    uint8_t *inline_vertices;
+    size_t inline_vertices_offset;
+    SDL_XGU_Bundle *recording; // Bundle that command queue runs are recorded into, NULL when rendering
+    SDL_XGU_Bundle *bundles; // Every bundle of the renderer, so destroyed textures can be detached from them
+    uint32_t *index_stream;
+    size_t index_stream_length;
+    size_t index_stream_capacity;
+    size_t index_stream_read;
+    xgu_readback_t *readbacks;
+    int readback_count;
+    int readback_capacity;
+    bool atlas_enabled;
+    xgu_atlas_page_t *atlas_pages;
+    size_t compressed_saving; // Sum of compressed_saving of every texture
+    xgu_render_target_dma_t render_target_dmas[SDL_XGU_RENDER_TARGET_DMA_CONTEXTS];
+    int active_render_target_dma; // Index into render_target_dmas of the active render target, -1 for the back buffer
+    bool render_target_written;   // Something was drawn to the active render target since it was set
+    struct s_CtxDma fence_dma_ctx;
 } xgu_render_data_t;
 
 // Forward declarations
 static inline void combiner_init(void);
-static inline void texture_combiner_apply(void);
-static inline void unlit_combiner_apply(void);
+static inline uint32_t *texture_combiner_apply(uint32_t *p);
+static inline uint32_t *unlit_combiner_apply(uint32_t *p);
+static inline uint32_t *yuv_combiner_apply(uint32_t *p, const xgu_texture_t *xgu_texture);
+static inline uint32_t *yuv_combiner_stage_apply(uint32_t *p, const xgu_texture_t *xgu_texture, int stage);
+static void state_push(xgu_render_data_t *render_data, enum xgu_state_type type, const uint32_t *start, const uint32_t *end);
+static void state_forget(xgu_render_data_t *render_data, uint32_t method);
+static void state_invalidate(xgu_render_data_t *render_data);
 static void set_blend_mode(SDL_Renderer *renderer, SDL_BlendMode blendMode);
 static SDL_Rect sanitize_scissor_rect(SDL_Renderer *renderer, const SDL_Rect *rect);
 static void set_surface_color_format(const int bpp);
-static void *arena_allocate(SDL_Renderer *renderer, size_t size, size_t *vertex_data_offset);
+static void *arena_allocate(SDL_Renderer *renderer, size_t size, size_t alignment, size_t *vertex_data_offset);
 static bool arena_init(SDL_Renderer *renderer);
+static void *vertex_allocate(SDL_Renderer *renderer, size_t size, size_t alignment, size_t *vertex_data_offset, bool allow_inline);
+static xgu_arena_chunk_t *arena_add_chunk(xgu_render_data_t *render_data, size_t size);
+static void arena_shrink(xgu_render_data_t *render_data);
+static void arena_destroy(xgu_render_data_t *render_data);
+static uint32_t *index_stream_reserve(SDL_Renderer *renderer, size_t count);
 static bool sdl_to_xgu_texture_format(SDL_PixelFormat sdl_format, int *xgu_texture_format, int *bytes_per_pixel, bool swizzled);
 static bool sdl_to_xgu_surface_format(SDL_PixelFormat sdl_format, int *xgu_surface_format, int *bytes_per_pixel);
 static inline uint32_t npot2pot(uint32_t num);
+static bool texture_rect_is_whole(const xgu_texture_t *xgu_texture, const SDL_Rect *rect);
+static bool atlas_allocate(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture, int width, int height);
+static void atlas_release(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture);
+static void atlas_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const uint8_t *src, int pitch);
+static bool compressed_texture_create(xgu_render_data_t *render_data, SDL_Texture *texture, xgu_texture_t *xgu_texture,
+                                      SDL_PropertiesID create_props);
+static bool compressed_texture_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const uint8_t *src, int pitch);
+static void texture_acquire_writable(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture, bool preserve);
+static bool palette_create(xgu_texture_t *xgu_texture);
+static bool palette_sync(xgu_render_data_t *render_data, SDL_Texture *texture, xgu_texture_t *xgu_texture);
+static bool grow_array(void **array, size_t *capacity, size_t needed, size_t element_size);
+static size_t yuv_texture_layout(xgu_texture_t *xgu_texture, SDL_PixelFormat format, SDL_PropertiesID create_props);
+static void yuv_texture_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const Uint8 *y_plane, int y_pitch,
+                               const Uint8 *u_plane, int u_pitch, const Uint8 *v_plane, int v_pitch);
+static inline bool frame_in_flight(const xgu_render_data_t *render_data, uint32_t frame);
+static xgu_render_target_dma_t *render_target_dma_acquire(xgu_render_data_t *render_data, const uint8_t *data, uint32_t limit);
+static void wait_for_frame(xgu_render_data_t *render_data, uint32_t frame);
+static void wait_for_last_use(xgu_render_data_t *render_data, uint32_t frame);
+static SDL_Surface *read_target_pixels(const xgu_texture_t *target, const uint8_t *back_buffer,
+                                       SDL_PixelFormat format, const SDL_Rect *rect);
+static void readbacks_complete(xgu_render_data_t *render_data, const xgu_texture_t *source, bool idle);
+static void readbacks_settle(xgu_render_data_t *render_data, const xgu_texture_t *source);
+static void track_vblank(xgu_render_data_t *render_data, Uint64 flip_ns);
+static void bundle_reserve(SDL_XGU_Bundle *bundle, size_t dwords);
+static void bundle_add_viewport_patch(SDL_XGU_Bundle *bundle, size_t index);
+static void bundle_add_texture(SDL_XGU_Bundle *bundle, xgu_texture_t *xgu_texture, int palette_index);
+static void bundles_detach_texture(xgu_render_data_t *render_data, const xgu_texture_t *xgu_texture);
+static void *bundle_allocate_vertices(SDL_XGU_Bundle *bundle, size_t size, size_t alignment, size_t *vertex_data_offset);
+
+// Every geometry command adds an entry to the index stream. The entry starts with a header of
+// { vertex count, index count, primitive, vertex format, palette copy } and is followed by the indices.
+// Non-indexed geometry has an index count of 0. The palette copy is the one an INDEX8 texture had when the
+// command was queued.
+enum index_header
+{
+    INDEX_HEADER_VERTEX_COUNT,
+    INDEX_HEADER_INDEX_COUNT,
+    INDEX_HEADER_PRIMITIVE,
+    INDEX_HEADER_VERTEX_FORMAT,
+    INDEX_HEADER_PALETTE,
+    INDEX_HEADER_SIZE,
+};
 
 enum fps_stage
 {
@@ -111,10 +408,121 @@ enum fps_stage
     FPS_STAGE_DISPLAY,
 };
 static void calculate_fps(enum fps_stage stage);
+static void stats_publish(SDL_Renderer *renderer);
 
 // pushbuffer pointer
 static uint32_t *p = NULL;
 
+// Start of the pushbuffer block that is open while the command queue runs, NULL if none is open
+static uint32_t *push_block = NULL;
+
+// While a bundle is recorded the command queue is pushed into it instead of the pushbuffer
+static SDL_XGU_Bundle *push_bundle = NULL;
+
+// Dwords pushed through push_reserve since the last frame's statistics were published
+static size_t push_dwords = 0;
+
+// Pushbuffer capture started by SDL_XGU_CapturePushbuffer, capture_io is NULL while no capture is running.
+// A new capture waits in capture_pending_io until the current frame has been presented.
+static SDL_IOStream *capture_io = NULL;
+static SDL_IOStream *capture_pending_io = NULL;
+static int capture_frames_left = 0;
+static uint32_t capture_frame = 0;
+static uint16_t capture_tag = XGU_CAPTURE_TAG_OTHER;
+// Start of the dwords in the open pbkit segment that have not been written to the capture yet
+static uint32_t *capture_start = NULL;
+
+static void capture_stop(void)
+{
+    if (capture_pending_io) {
+        SDL_CloseIO(capture_pending_io);
+        capture_pending_io = NULL;
+    }
+    if (capture_io && !SDL_CloseIO(capture_io)) {
+        SDL_Log("[nxdk renderer] Pushbuffer capture could not be written: %s", SDL_GetError());
+    }
+    capture_io = NULL;
+}
+
+static void capture_write(const uint32_t *end, uint16_t flags)
+{
+    const xgu_capture_record_t record = {
+        .frame = capture_frame,
+        .tag = capture_tag,
+        .flags = flags,
+        .dword_count = (uint32_t)(end - capture_start),
+    };
+    if (SDL_WriteIO(capture_io, &record, sizeof(record)) != sizeof(record) ||
+        SDL_WriteIO(capture_io, capture_start, record.dword_count * sizeof(uint32_t)) != record.dword_count * sizeof(uint32_t)) {
+        SDL_Log("[nxdk renderer] Pushbuffer capture stopped: %s", SDL_GetError());
+        capture_stop();
+    }
+}
+
+// Tags the dwords pushed from here on. Dwords already pushed to the open segment keep the previous tag.
+static inline void capture_set_tag(uint16_t tag)
+{
+    if (capture_io == NULL || tag == capture_tag) {
+        return;
+    }
+    if (push_block && push_bundle == NULL && p != capture_start) {
+        capture_write(p, 0);
+        capture_start = p;
+    }
+    capture_tag = tag;
+}
+
+static inline uint32_t *push_begin(void)
+{
+    capture_start = pb_begin();
+    return capture_start;
+}
+
+static inline void push_end(uint32_t *end)
+{
+    if (capture_io) {
+        capture_write(end, XGU_CAPTURE_FLAG_SEGMENT_END);
+    }
+    pb_end(end);
+}
+
+// Makes sure there is room for dwords more dwords at p. Commands from one command queue run share a pushbuffer
+// block, it is only closed with pb_end when it is full or when pbkit needs to push something itself.
+static inline void push_reserve(size_t dwords)
+{
+    assert(dwords <= SDL_XGU_PUSH_BLOCK_SIZE);
+    if (push_bundle) {
+        bundle_reserve(push_bundle, dwords);
+        return;
+    }
+    if (push_block && (size_t)(p - push_block) + dwords > SDL_XGU_PUSH_BLOCK_SIZE) {
+        push_dwords += p - push_block;
+        push_end(p);
+        push_block = NULL;
+    }
+    if (push_block == NULL) {
+        p = push_begin();
+        push_block = p;
+    }
+}
+
+// Closes the open pushbuffer block and kicks it off to the GPU
+static inline void push_flush(void)
+{
+    if (push_bundle) {
+        if (push_block && !push_bundle->failed) {
+            push_bundle->command_count = p - push_bundle->commands;
+        }
+        push_block = NULL;
+        return;
+    }
+    if (push_block) {
+        push_dwords += p - push_block;
+        push_end(p);
+        push_block = NULL;
+    }
+}
+
 static void XBOX_WindowEvent(SDL_Renderer *renderer, const SDL_WindowEvent *event)
 {
     (void)renderer;
@@ -131,6 +539,16 @@ static bool XBOX_CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture, SDL
 
     const bool is_render_target = SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_ACCESS_NUMBER, 0) == SDL_TEXTUREACCESS_TARGET;
 
+    // Precompressed DXT data replaces the pixel format the texture was created with
+    if (SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_FORMAT_NUMBER, SDL_XGU_COMPRESSED_NONE) != SDL_XGU_COMPRESSED_NONE) {
+        if (!compressed_texture_create(render_data, texture, xgu_texture, create_props)) {
+            SDL_free(xgu_texture);
+            return false;
+        }
+        texture->internal = xgu_texture;
+        return true;
+    }
+
     // If this is a render target, we need to check if the render target format is supported
     if (is_render_target) {
         int surface_format;
@@ -146,6 +564,18 @@ static bool XBOX_CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture, SDL
         xgu_texture->swizzled = 1;
     }
 
+    xgu_texture->streaming = SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_ACCESS_NUMBER, 0) == SDL_TEXTUREACCESS_STREAMING;
+
+    // The NV2A only reads indexed textures swizzled, so streaming INDEX8 textures are updated with SDL_UpdateTexture
+    // instead of being locked,
+    if (texture->format == SDL_PIXELFORMAT_INDEX8) {
+        xgu_texture->swizzled = 1;
+    }
+    // and YUV textures only linear
+    if (SDL_ISPIXELFORMAT_FOURCC(texture->format)) {
+        xgu_texture->swizzled = 0;
+    }
+
     // Ensure the texture format is supported
     if (sdl_to_xgu_texture_format(texture->format, &xgu_texture->format, &xgu_texture->bytes_per_pixel, xgu_texture->swizzled) == false) {
         SDL_free(xgu_texture);
@@ -157,6 +587,16 @@ static bool XBOX_CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture, SDL
     xgu_texture->data_width = texture->w;
     xgu_texture->data_height = texture->h;
 
+    // Small static textures share atlas pages, so they don't each round up to a power of two and draws that
+    // use different textures on the same page can be merged
+    if (render_data->atlas_enabled && xgu_texture->swizzled && texture->format != SDL_PIXELFORMAT_INDEX8 &&
+        texture->w <= SDL_XGU_ATLAS_MAX_TEXTURE_SIZE && texture->h <= SDL_XGU_ATLAS_MAX_TEXTURE_SIZE &&
+        SDL_GetBooleanProperty(create_props, SDL_PROP_TEXTURE_CREATE_XGU_ATLAS_BOOLEAN, true) &&
+        atlas_allocate(render_data, xgu_texture, texture->w, texture->h)) {
+        texture->internal = xgu_texture;
+        return true;
+    }
+
     // Texture must be atleast 8 bytes
     xgu_texture->data_width = SDL_max(xgu_texture->data_width, 8 / xgu_texture->bytes_per_pixel);
     xgu_texture->data_height = SDL_max(xgu_texture->data_height, 8 / xgu_texture->bytes_per_pixel);
@@ -186,9 +626,15 @@ static bool XBOX_CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture, SDL
     }
 
     xgu_texture->pitch = xgu_texture->data_width * xgu_texture->bytes_per_pixel;
+    xgu_texture->planes = 1;
+
+    SIZE_T allocation_size = xgu_texture->data_height * xgu_texture->pitch;
+    if (SDL_ISPIXELFORMAT_FOURCC(texture->format)) {
+        allocation_size = yuv_texture_layout(xgu_texture, texture->format, create_props);
+    }
+    xgu_texture->buffer_size = allocation_size;
 
-    const SIZE_T allocation_size = xgu_texture->data_height * xgu_texture->pitch;
-    xgu_texture->data = MmAllocateContiguousMemoryEx(allocation_size, 0, SDL_MAX_UINT32, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
+    xgu_texture->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, allocation_size);
     if (xgu_texture->data == NULL) {
         SDL_free(xgu_texture);
         return SDL_OutOfMemory();
@@ -196,6 +642,15 @@ static bool XBOX_CreateTexture(SDL_Renderer *renderer, SDL_Texture *texture, SDL
     xgu_texture->data_physical_address = (uint8_t *)MmGetPhysicalAddress(xgu_texture->data);
     SDL_memset(xgu_texture->data, 0, allocation_size);
 
+    xgu_texture->buffers[0].data = xgu_texture->data;
+    xgu_texture->buffers[0].physical_address = xgu_texture->data_physical_address;
+
+    if (texture->format == SDL_PIXELFORMAT_INDEX8 && !palette_create(xgu_texture)) {
+        contiguous_heap_free(xgu_texture->data);
+        SDL_free(xgu_texture);
+        return SDL_OutOfMemory();
+    }
+
     texture->internal = xgu_texture;
     return true;
 }
@@ -208,7 +663,46 @@ static void XBOX_DestroyTexture(SDL_Renderer *renderer, SDL_Texture *texture)
         return;
     }
 
-    MmFreeContiguousMemory(xgu_texture->data);
+    // Finish any readbacks from this render target before its memory goes away
+    for (int i = 0; i < render_data->readback_count; i++) {
+        if (render_data->readbacks[i].source == xgu_texture) {
+            while (pb_busy()) {
+                Sleep(0);
+            }
+            readbacks_complete(render_data, xgu_texture, true);
+            break;
+        }
+    }
+
+    // Bundles drawing this texture can't be drawn anymore
+    bundles_detach_texture(render_data, xgu_texture);
+
+    // Don't free memory the GPU may still read or render to for a frame in flight
+    bool in_flight = (render_data->active_render_target == xgu_texture);
+    for (int i = 0; i < SDL_XGU_STREAMING_BUFFER_COUNT; i++) {
+        in_flight |= frame_in_flight(render_data, xgu_texture->buffers[i].last_used_frame);
+    }
+    for (size_t i = 0; i < xgu_texture->palette_count; i++) {
+        in_flight |= frame_in_flight(render_data, xgu_texture->palettes[i].last_used_frame);
+    }
+    if (in_flight) {
+        while (pb_busy()) {
+            Sleep(0);
+        }
+    }
+    // A new texture could be allocated at the same address, make sure its offset is pushed again
+    state_forget(render_data, NV097_SET_TEXTURE_OFFSET);
+    state_forget(render_data, NV097_SET_TEXTURE_PALETTE);
+
+    for (int i = 0; i < SDL_XGU_STREAMING_BUFFER_COUNT; i++) {
+        contiguous_heap_free(xgu_texture->buffers[i].data);
+    }
+    for (size_t i = 0; i < xgu_texture->palette_count; i++) {
+        contiguous_heap_free(xgu_texture->palettes[i].data);
+    }
+    SDL_free(xgu_texture->palettes);
+    atlas_release(render_data, xgu_texture);
+    render_data->compressed_saving -= xgu_texture->compressed_saving;
     SDL_free(xgu_texture);
     texture->internal = NULL;
 }
@@ -217,9 +711,21 @@ static bool XBOX_LockTexture(SDL_Renderer *renderer, SDL_Texture *texture, const
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
     xgu_texture_t *xgu_texture = (xgu_texture_t *)texture->internal;
+
+    if (xgu_texture->swizzled) {
+        return SDL_SetError("[nxdk renderer] Swizzled textures can't be locked, use SDL_UpdateTexture");
+    }
+    // The planes are returned in the layout they are stored in, which only matches SDL's for the whole texture
+    if (xgu_texture->planes > 1 && !texture_rect_is_whole(xgu_texture, rect)) {
+        return SDL_SetError("[nxdk renderer] Planar YUV textures can only be locked whole");
+    }
+
+    // Locked pixels are write only, so the old contents only need carrying over if part of the texture is locked
+    texture_acquire_writable(render_data, xgu_texture, !texture_rect_is_whole(xgu_texture, rect));
+    render_data->stats.texture_uploads++;
+
     uint8_t *pixels8 = (uint8_t *)xgu_texture->data;
 
-    // We don't need to worry about unswizzling because you can only lock textures that are not swizzled
     *pixels = &pixels8[rect->y * xgu_texture->pitch +
                        rect->x * xgu_texture->bytes_per_pixel];
 
@@ -241,33 +747,39 @@ static bool XBOX_UpdateTexture(SDL_Renderer *renderer, SDL_Texture *texture,
     xgu_texture_t *xgu_texture = (xgu_texture_t *)texture->internal;
     const Uint8 *src = pixels;
 
-    if (xgu_texture->swizzled) {
+    texture_acquire_writable(render_data, xgu_texture, !texture_rect_is_whole(xgu_texture, rect));
+    render_data->stats.texture_uploads++;
+
+    if (xgu_texture->block_size) {
+        return compressed_texture_update(xgu_texture, rect, src, pitch);
+    }
+
+    if (xgu_texture->planes > 1) {
+        // SDL passes the planes one after the other, the chroma planes with half the pitch of the Y plane
+        const int chroma_pitch = (pitch + 1) / 2;
+        const Uint8 *chroma = src + rect->h * pitch;
+        const Uint8 *second_chroma = chroma + chroma_pitch * ((rect->h + 1) / 2);
+        if (xgu_texture->planes == 2) {
+            yuv_texture_update(xgu_texture, rect, src, pitch, chroma, chroma_pitch * 2, NULL, 0);
+        } else if (texture->format == SDL_PIXELFORMAT_YV12) {
+            yuv_texture_update(xgu_texture, rect, src, pitch, second_chroma, chroma_pitch, chroma, chroma_pitch);
+        } else {
+            yuv_texture_update(xgu_texture, rect, src, pitch, chroma, chroma_pitch, second_chroma, chroma_pitch);
+        }
+    } else if (xgu_texture->atlas_page) {
+        render_data->stats.swizzled_bytes += (size_t)rect->w * rect->h * SDL_BYTESPERPIXEL(texture->format);
+        atlas_update(xgu_texture, rect, src, pitch);
+    } else if (xgu_texture->swizzled) {
+        render_data->stats.swizzled_bytes += (size_t)rect->w * rect->h * SDL_BYTESPERPIXEL(texture->format);
+
         // If we are updating the entire texture, we can swizzle it entirely
-        if (rect->x == 0 && rect->y == 0 &&
-            rect->w == xgu_texture->tex_width && rect->h == xgu_texture->tex_height) {
+        if (texture_rect_is_whole(xgu_texture, rect)) {
             swizzle_rect(src, xgu_texture->tex_width, xgu_texture->tex_height, xgu_texture->data, pitch, SDL_BYTESPERPIXEL(texture->format));
         }
-        // Otherwise we need to unswizzle, update the texture then swizzle again
+        // Otherwise only swizzle the pixels inside the rect into place
         else {
-            // Unswizzle the whole texture to a temporary buffer
-            uint8_t *unswizzled = (uint8_t *)SDL_malloc(xgu_texture->pitch * xgu_texture->tex_height);
-            if (unswizzled == NULL) {
-                return SDL_OutOfMemory();
-            }
-            unswizzle_rect(xgu_texture->data, xgu_texture->tex_width, xgu_texture->tex_height,
-                           unswizzled, xgu_texture->pitch, SDL_BYTESPERPIXEL(texture->format));
-
-            // Copy the new pixels into the unswizzled buffer
-            uint8_t *dst = &((uint8_t *)unswizzled)[rect->y * xgu_texture->pitch +
-                                                    rect->x * xgu_texture->bytes_per_pixel];
-            SDL_ConvertPixels(rect->w, rect->h,
-                              texture->format, src, pitch,
-                              texture->format, dst, xgu_texture->pitch);
-
-            // Now swizzle the unswizzled buffer back to the texture
-            swizzle_rect(unswizzled, xgu_texture->tex_width, xgu_texture->tex_height, xgu_texture->data,
-                         xgu_texture->pitch, SDL_BYTESPERPIXEL(texture->format));
-            SDL_free(unswizzled);
+            swizzle_subrect(src, rect->x, rect->y, rect->w, rect->h, xgu_texture->data,
+                            xgu_texture->tex_width, xgu_texture->tex_height, pitch, SDL_BYTESPERPIXEL(texture->format));
         }
     } else {
         uint8_t *dst = &((uint8_t *)xgu_texture->data)[rect->y * xgu_texture->pitch +
@@ -280,6 +792,33 @@ static bool XBOX_UpdateTexture(SDL_Renderer *renderer, SDL_Texture *texture,
     return true;
 }
 
+#ifdef SDL_HAVE_YUV
+static bool XBOX_UpdateTextureYUV(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *rect,
+                                  const Uint8 *Yplane, int Ypitch, const Uint8 *Uplane, int Upitch,
+                                  const Uint8 *Vplane, int Vpitch)
+{
+    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    xgu_texture_t *xgu_texture = (xgu_texture_t *)texture->internal;
+
+    texture_acquire_writable(render_data, xgu_texture, !texture_rect_is_whole(xgu_texture, rect));
+    render_data->stats.texture_uploads++;
+    yuv_texture_update(xgu_texture, rect, Yplane, Ypitch, Uplane, Upitch, Vplane, Vpitch);
+    return true;
+}
+
+static bool XBOX_UpdateTextureNV(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *rect,
+                                 const Uint8 *Yplane, int Ypitch, const Uint8 *UVplane, int UVpitch)
+{
+    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    xgu_texture_t *xgu_texture = (xgu_texture_t *)texture->internal;
+
+    texture_acquire_writable(render_data, xgu_texture, !texture_rect_is_whole(xgu_texture, rect));
+    render_data->stats.texture_uploads++;
+    yuv_texture_update(xgu_texture, rect, Yplane, Ypitch, UVplane, UVpitch, NULL, 0);
+    return true;
+}
+#endif
+
 static bool XBOX_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
@@ -287,6 +826,12 @@ static bool XBOX_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture)
     xgu_texture_t *xgu_texture = (texture) ? (xgu_texture_t *)texture->internal : NULL;
     extern unsigned int pb_ColorFmt; // From pbkit.c
 
+    // The DMA context of the previous render target was rendered through up until this frame
+    if (render_data->active_render_target_dma >= 0) {
+        render_data->render_target_dmas[render_data->active_render_target_dma].last_used_frame = render_data->frame_serial;
+        render_data->active_render_target_dma = -1;
+    }
+
     if (xgu_texture == NULL) {
         set_surface_color_format(XVideoGetMode().bpp);
 
@@ -302,17 +847,13 @@ static bool XBOX_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture)
         // All the checks during texture creation should ensure this never fails
         assert(status);
 
-        // Ensure idle before messing with DMA channels
-        p = pb_begin();
-        p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-        pb_end(p);
-
-        pb_set_dma_address(&render_data->render_target_dma_ctx, xgu_texture->data, xgu_texture->pitch * xgu_texture->data_height - 1);
+        xgu_render_target_dma_t *dma = render_target_dma_acquire(render_data, xgu_texture->data,
+                                                                 xgu_texture->pitch * xgu_texture->data_height - 1);
 
         // Ensures any surface fills are done with the appropriate colour format while rendering to this target
         set_surface_color_format(bytes_per_pixel * 8);
 
-        dma_channel = render_data->render_target_dma_ctx.ChannelID;
+        dma_channel = dma->ctx.ChannelID;
         pitch = xgu_texture->pitch;
         clip_width = xgu_texture->tex_width;
         clip_height = xgu_texture->tex_height;
@@ -326,9 +867,13 @@ static bool XBOX_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture)
     // Z24S8 format has 4 bytes per pixel for the zeta buffer
     zpitch = pb_back_buffer_width() * 4;
 
-    p = pb_begin();
+    p = push_begin();
 
-    p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+    // The GPU handles surface changes in order with the draws before them, so it only needs to go idle when the
+    // previous target is a texture that was drawn to. Its pixels must be in memory before anything samples it.
+    if (render_data->active_render_target && render_data->render_target_written) {
+        p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+    }
     p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, dma_channel);
 
     p = pb_push1(p, NV097_SET_SURFACE_PITCH,
@@ -343,17 +888,62 @@ static bool XBOX_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture)
                      XGU_MASK(NV097_SET_SURFACE_CLIP_VERTICAL_Y, 0));
     p = pb_push1(p, NV097_SET_SURFACE_FORMAT, format);
 
-    pb_end(p);
+    push_end(p);
+
+    // The previous render target was drawn to up until this frame
+    if (render_data->active_render_target) {
+        xgu_texture_t *previous = (xgu_texture_t *)render_data->active_render_target;
+        previous->buffers[previous->buffer_index].last_used_frame = render_data->frame_serial;
+    }
 
     render_data->active_render_target = xgu_texture;
+    render_data->render_target_written = false;
     return true;
 }
 
+// Returns a render target DMA context that covers data to data + limit. A context already covering it is reused,
+// otherwise the least recently used one is rebound. The GPU only needs to be idle for the rebind if a frame in
+// flight, including the current one, rendered through that context.
+static xgu_render_target_dma_t *render_target_dma_acquire(xgu_render_data_t *render_data, const uint8_t *data, uint32_t limit)
+{
+    int index = 0;
+    for (int i = 0; i < SDL_XGU_RENDER_TARGET_DMA_CONTEXTS; i++) {
+        const xgu_render_target_dma_t *dma = &render_data->render_target_dmas[i];
+        if (dma->data == data && dma->limit == limit) {
+            index = i;
+            break;
+        }
+        if ((int32_t)(dma->last_used_frame - render_data->render_target_dmas[index].last_used_frame) < 0) {
+            index = i;
+        }
+    }
+
+    xgu_render_target_dma_t *dma = &render_data->render_target_dmas[index];
+    if (dma->data != data || dma->limit != limit) {
+        if (frame_in_flight(render_data, dma->last_used_frame)) {
+            p = push_begin();
+            p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+            push_end(p);
+
+            while (pb_busy()) {
+                Sleep(0);
+            }
+        }
+        pb_set_dma_address(&dma->ctx, (void *)data, limit);
+        dma->data = data;
+        dma->limit = limit;
+    }
+
+    render_data->active_render_target_dma = index;
+    return dma;
+}
+
 static bool XBOX_QueueDrawPoints(SDL_Renderer *renderer, SDL_RenderCommand *cmd, const SDL_FPoint *points, int count)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
 
-    uint8_t *vertices = (uint8_t *)arena_allocate(renderer, count * sizeof(xgu_point_t), &cmd->data.draw.first);
+    uint8_t *vertices = (uint8_t *)vertex_allocate(renderer, count * sizeof(xgu_point_t), SDL_XGU_VERTEX_ALIGNMENT,
+                                                   &cmd->data.draw.first, true);
     if (!vertices) {
         return SDL_OutOfMemory();
     }
@@ -369,6 +959,33 @@ static bool XBOX_QueueDrawPoints(SDL_Renderer *renderer, SDL_RenderCommand *cmd,
     return true;
 }
 
+// Checks if the indices describe a list of quads that have each been split into the triangles (0, 1, 2) and (0, 2, 3).
+// This is how SDL submits texture copies and filled rects.
+static bool is_quad_list(const void *indices, int num_indices, int size_indices, int num_vertices)
+{
+    static const int quad_index_order[] = { 0, 1, 2, 0, 2, 3 };
+
+    if (indices == NULL || (num_vertices % 4) != 0 || num_indices != (num_vertices / 4) * 6) {
+        return false;
+    }
+
+    for (int i = 0; i < num_indices; i++) {
+        const int expected = (i / 6) * 4 + quad_index_order[i % 6];
+        int index;
+        if (size_indices == 4) {
+            index = ((const uint32_t *)indices)[i];
+        } else if (size_indices == 2) {
+            index = ((const uint16_t *)indices)[i];
+        } else {
+            index = ((const uint8_t *)indices)[i];
+        }
+        if (index != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static bool XBOX_QueueGeometry(SDL_Renderer *renderer, SDL_RenderCommand *cmd, SDL_Texture *texture,
                                const float *xy, int xy_stride, const SDL_FColor *color, int color_stride,
                                const float *uv, int uv_stride,
@@ -376,58 +993,94 @@ static bool XBOX_QueueGeometry(SDL_Renderer *renderer, SDL_RenderCommand *cmd, S
                                float scale_x, float scale_y)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
-    const int count = indices ? num_indices : num_vertices;
-    const size_t sz = (texture) ? sizeof(xgu_vertex_textured_t) : sizeof(xgu_vertex_t);
-    const float color_scale = cmd->data.draw.color_scale;
+    const int count = num_vertices;
+    const xgu_texture_t *xgu_texture = (texture) ? (xgu_texture_t *)texture->internal : NULL;
+    const vertex_pack_source_t source = {
+        .xy = xy,
+        .xy_stride = xy_stride,
+        .color = (const float *)color,
+        .color_stride = color_stride,
+        .uv = (texture) ? uv : NULL,
+        .uv_stride = uv_stride,
+        .num_vertices = num_vertices,
+        .scale_x = scale_x,
+        .scale_y = scale_y,
+        .u_scale = (xgu_texture) ? xgu_texture->u_scale : 0.0f,
+        .v_scale = (xgu_texture) ? xgu_texture->v_scale : 0.0f,
+        .u_offset = (xgu_texture) ? xgu_texture->u_offset : 0.0f,
+        .v_offset = (xgu_texture) ? xgu_texture->v_offset : 0.0f,
+        .color_scale = cmd->data.draw.color_scale,
+    };
+
+    // The neighbours of a texture in the atlas would show through if it wrapped, so it is always clamped
+    if (xgu_texture && xgu_texture->atlas_page &&
+        (cmd->data.draw.texture_address_mode_u == SDL_TEXTURE_ADDRESS_WRAP ||
+         cmd->data.draw.texture_address_mode_v == SDL_TEXTURE_ADDRESS_WRAP)) {
+        static bool logged = false;
+        if (!logged) {
+            SDL_Log("[nxdk renderer] Textures in the atlas can't wrap, create them with "
+                    "SDL_PROP_TEXTURE_CREATE_XGU_ATLAS_BOOLEAN set to false");
+            logged = true;
+        }
+    }
+
+    // Use 16-bit positions and texture coordinates if the geometry is pixel aligned
+    enum vertex_format format = (texture) ? VERTEX_FORMAT_TEXTURED : VERTEX_FORMAT_COLOR;
+    if (SDL_XGU_COMPACT_VERTICES && vertex_pack_fits_compact(&source)) {
+        format = (texture) ? VERTEX_FORMAT_TEXTURED_COMPACT : VERTEX_FORMAT_COLOR_COMPACT;
+    }
+    const size_t sz = vertex_format_stride(format);
+    num_indices = indices ? num_indices : 0;
+
+    // Draws read the palette that was set when they were queued, not the one set when the command queue is run
+    if (xgu_texture && xgu_texture->palettes && !palette_sync(render_data, texture, (xgu_texture_t *)xgu_texture)) {
+        return SDL_OutOfMemory();
+    }
+
+    // Reserve the index stream entry first, it is only committed once the vertices are in the arena
+    uint32_t *index_entry = index_stream_reserve(renderer, INDEX_HEADER_SIZE + num_indices);
+    if (index_entry == NULL) {
+        return SDL_OutOfMemory();
+    }
 
-    uint8_t *vertices = (uint8_t *)arena_allocate(renderer, count * sz, &cmd->data.draw.first);
+    // Geometry is only aligned to the size of a float so that consecutive geometry lands back to back
+    // in the arena. XBOX_RunCommandQueue can then merge compatible runs into a single draw.
+    // Planar YUV textures read the texture coordinates on several texture units, which inline vertices can't do.
+    const bool allow_inline = (xgu_texture == NULL || xgu_texture->planes <= 1);
+    uint8_t *vertices = (uint8_t *)vertex_allocate(renderer, count * sz, sizeof(float), &cmd->data.draw.first, allow_inline);
     if (vertices == NULL) {
         return SDL_OutOfMemory();
     }
 
     cmd->data.draw.count = count;
-    size_indices = indices ? size_indices : 0;
 
-    for (int i = 0; i < count; i++) {
-        int j;
+    // SDL's copies and fill rects arrive as quads split into two triangles. The NV2A can draw quads directly
+    // so these are drawn as a non-indexed quad list which needs 4 vertices per quad instead of 6 indices.
+    if (is_quad_list(indices, num_indices, size_indices, count)) {
+        num_indices = 0;
+        index_entry[INDEX_HEADER_PRIMITIVE] = XGU_QUADS;
+    } else {
+        index_entry[INDEX_HEADER_PRIMITIVE] = XGU_TRIANGLES;
+    }
+
+    // Indexed geometry stays indexed. Only the unique vertices go into the arena and the indices are kept
+    // in system memory until the command queue is run, where they are pushed as an element array.
+    index_entry[INDEX_HEADER_VERTEX_FORMAT] = format;
+    index_entry[INDEX_HEADER_VERTEX_COUNT] = count;
+    index_entry[INDEX_HEADER_INDEX_COUNT] = num_indices;
+    index_entry[INDEX_HEADER_PALETTE] = (xgu_texture) ? xgu_texture->palette_index : 0;
+    for (int i = 0; i < num_indices; i++) {
         if (size_indices == 4) {
-            j = ((const uint32_t *)indices)[i];
+            index_entry[INDEX_HEADER_SIZE + i] = ((const uint32_t *)indices)[i];
         } else if (size_indices == 2) {
-            j = ((const uint16_t *)indices)[i];
-        } else if (size_indices == 1) {
-            j = ((const uint8_t *)indices)[i];
+            index_entry[INDEX_HEADER_SIZE + i] = ((const uint16_t *)indices)[i];
         } else {
-            j = i;
-        }
-
-        // We could keep the color as four floats but we can save alot of vertex buffer space making it uint_8_t
-        const SDL_FColor *vertex_color = (SDL_FColor *)((intptr_t)color + j * color_stride);
-        const uint32_t r = (uint32_t)(vertex_color->r * color_scale * 255.0f);
-        const uint32_t g = (uint32_t)(vertex_color->g * color_scale * 255.0f);
-        const uint32_t b = (uint32_t)(vertex_color->b * color_scale * 255.0f);
-        const uint32_t a = (uint32_t)(vertex_color->a * 255.0f);
-
-        // Populate the common vertex data
-        const float *vertex_pos = (float *)((char *)xy + j * xy_stride);
-        xgu_vertex_t *xgu_vertex = (xgu_vertex_t *)vertices;
-        xgu_vertex->pos[0] = vertex_pos[0] * scale_x;
-        xgu_vertex->pos[1] = vertex_pos[1] * scale_y;
-        xgu_vertex->color[0] = (uint8_t)SDL_min(r, UINT8_MAX);
-        xgu_vertex->color[1] = (uint8_t)SDL_min(g, UINT8_MAX);
-        xgu_vertex->color[2] = (uint8_t)SDL_min(b, UINT8_MAX);
-        xgu_vertex->color[3] = (uint8_t)SDL_min(a, UINT8_MAX);
-
-        if (texture) {
-            xgu_vertex_textured_t *xgu_texture_vertex = (xgu_vertex_textured_t *)vertices;
-            const xgu_texture_t *xgu_texture = (xgu_texture_t *)texture->internal;
-            const float *vertex_uv = (float *)((char *)uv + j * uv_stride);
-            xgu_texture_vertex->tex[0] = vertex_uv[0] * xgu_texture->u_scale;
-            xgu_texture_vertex->tex[1] = vertex_uv[1] * xgu_texture->v_scale;
-            vertices += sizeof(xgu_vertex_textured_t);
-        } else {
-            vertices += sizeof(xgu_vertex_t);
+            index_entry[INDEX_HEADER_SIZE + i] = ((const uint8_t *)indices)[i];
         }
     }
+    render_data->index_stream_length += INDEX_HEADER_SIZE + num_indices;
+
+    vertex_pack(&source, format, vertices);
     return true;
 }
 
@@ -443,11 +1096,6 @@ static bool XBOX_RenderSetViewPort(SDL_Renderer *renderer, SDL_RenderCommand *cm
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
     const SDL_Rect *viewport = &cmd->data.viewport.rect;
 
-    // If the new viewport is the same as the current one, no need to update
-    if (SDL_memcmp(viewport, &render_data->viewport, sizeof(SDL_Rect)) == 0) {
-        return true;
-    }
-
     // Create a new rect that is the intersection of the new viewport and the current clip rect
     // This is becaused SDL expects rendering to be clipped to the viewport and the clip rect
     // but we can only set one scissor at a time.
@@ -456,11 +1104,12 @@ static bool XBOX_RenderSetViewPort(SDL_Renderer *renderer, SDL_RenderCommand *cm
 
     scissor_clipped_rect = sanitize_scissor_rect(renderer, &scissor_clipped_rect);
 
-    p = pb_begin();
-    p = xgu_set_viewport_offset(p, viewport->x, viewport->y, 0.0f, 0.0f);
-    p = xgu_set_scissor_rect(p, false, scissor_clipped_rect.x, scissor_clipped_rect.y,
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    s = xgu_set_viewport_offset(s, viewport->x, viewport->y, 0.0f, 0.0f);
+    s = xgu_set_scissor_rect(s, false, scissor_clipped_rect.x, scissor_clipped_rect.y,
                              scissor_clipped_rect.w, scissor_clipped_rect.h);
-    pb_end(p);
+    state_push(render_data, XGU_STATE_VIEWPORT, state, s);
 
     // Store the viewport in the render data
     render_data->viewport = *viewport;
@@ -478,11 +1127,6 @@ static bool XBOX_RenderSetClipRect(SDL_Renderer *renderer, SDL_RenderCommand *cm
         *clip_rect = no_clip;
     }
 
-    // If the new clip rect is the same as the current one, no need to update
-    if (SDL_memcmp(clip_rect, &render_data->clip_rect, sizeof(SDL_Rect)) == 0) {
-        return true;
-    }
-
     // Create a new rect that is the intersection of the new clip rect and the current viewport
     // This is because SDL expects rendering to be clipped to the viewport and the clip rect
     // but we can only set one scissor at a time.
@@ -491,10 +1135,11 @@ static bool XBOX_RenderSetClipRect(SDL_Renderer *renderer, SDL_RenderCommand *cm
 
     scissor_clipped_rect = sanitize_scissor_rect(renderer, &scissor_clipped_rect);
 
-    p = pb_begin();
-    p = xgu_set_scissor_rect(p, false, scissor_clipped_rect.x, scissor_clipped_rect.y,
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    s = xgu_set_scissor_rect(s, false, scissor_clipped_rect.x, scissor_clipped_rect.y,
                              scissor_clipped_rect.w, scissor_clipped_rect.h);
-    pb_end(p);
+    state_push(render_data, XGU_STATE_VIEWPORT, state, s);
 
     // Store the clip rect in the render data
     render_data->clip_rect = *clip_rect;
@@ -505,9 +1150,11 @@ static bool XBOX_RenderSetDrawColor(SDL_Renderer *renderer, SDL_RenderCommand *c
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
     const SDL_FColor *color = &cmd->data.color.color;
-    p = pb_begin();
-    p = xgux_set_color4f(p, color->r, color->g, color->b, color->a);
-    pb_end(p);
+
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    s = xgux_set_color4f(s, color->r, color->g, color->b, color->a);
+    state_push(render_data, XGU_STATE_COLOR, state, s);
 
     return true;
 }
@@ -522,6 +1169,16 @@ static bool XBOX_RenderClear(SDL_Renderer *renderer, SDL_RenderCommand *cmd)
                              ((uint32_t)(color.b * 255.0f) << 0) |
                              ((uint32_t)(color.a * 255.0f) << 24);
 
+    // pb_fill pushes straight to the pushbuffer so it can't be recorded, SDL_XGU_EndBundle fails instead
+    if (render_data->recording) {
+        render_data->recording->cleared = true;
+        return SDL_SetError("[nxdk renderer] SDL_RenderClear can't be recorded into bundles");
+    }
+
+    // pb_fill pushes its own commands
+    push_flush();
+
+    render_data->render_target_written = true;
     if (render_data->active_render_target) {
         pb_fill(0, 0, render_data->active_render_target->tex_width,
                 render_data->active_render_target->tex_height, color32);
@@ -532,96 +1189,351 @@ static bool XBOX_RenderClear(SDL_Renderer *renderer, SDL_RenderCommand *cmd)
     return true;
 }
 
-static bool XBOX_RenderGeometry(SDL_Renderer *renderer, void *vertices, SDL_RenderCommand *cmd)
+// Draws the indices of one or more index stream entries as a single element array. The indices of each
+// entry are rebased by the vertices of the entries before it, as merged commands share one vertex array.
+static void draw_elements(XguPrimitiveType mode, const uint32_t *index_stream, size_t index_stream_length, size_t vertex_count)
 {
-    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
-    const size_t count = cmd->data.draw.count;
-
-    set_blend_mode(renderer, cmd->data.draw.blend);
-
-    if (cmd->data.draw.texture) {
-        xgu_texture_t *xgu_texture = (xgu_texture_t *)cmd->data.draw.texture->internal;
+    const uint32_t *end = index_stream + index_stream_length;
+    const bool use_16bit = vertex_count <= 0x10000;
+    const uint32_t method = (use_16bit) ? NV097_ARRAY_ELEMENT16 : NV097_ARRAY_ELEMENT32;
+    uint32_t batch[SDL_XGU_ELEMENT_BATCH];
+    int batch_count = 0;
+    uint32_t base = 0;
+    uint32_t pending = 0;
+    bool has_pending = false;
+
+    push_reserve(2);
+    p = xgu_begin(p, mode);
+
+    while (index_stream < end) {
+        const uint32_t entry_vertex_count = index_stream[INDEX_HEADER_VERTEX_COUNT];
+        const uint32_t entry_index_count = index_stream[INDEX_HEADER_INDEX_COUNT];
+        const uint32_t *indices = &index_stream[INDEX_HEADER_SIZE];
+
+        for (uint32_t i = 0; i < entry_index_count; i++) {
+            const uint32_t index = indices[i] + base;
+
+            // 16-bit elements are packed in pairs, the first of the pair is held until the second arrives
+            if (use_16bit) {
+                if (!has_pending) {
+                    pending = index;
+                    has_pending = true;
+                    continue;
+                }
+                batch[batch_count++] = pending | (index << 16);
+                has_pending = false;
+            } else {
+                batch[batch_count++] = index;
+            }
 
-        if (render_data->texture_shader_active == 0) {
-            p = pb_begin();
-            texture_combiner_apply();
-            pb_end(p);
-            render_data->texture_shader_active = 1;
+            if (batch_count == SDL_XGU_ELEMENT_BATCH) {
+                push_reserve(1 + batch_count);
+                p = push_command(p, method, batch_count);
+                SDL_memcpy(p, batch, batch_count * sizeof(uint32_t));
+                p += batch_count;
+                batch_count = 0;
+            }
         }
+        base += entry_vertex_count;
+        index_stream += INDEX_HEADER_SIZE + entry_index_count;
+    }
 
-        // Nearest filtering is used for nearest and pixelart scale modes
-        const XguTexFilter texture_filter =
-            (cmd->data.draw.texture_scale_mode == SDL_SCALEMODE_LINEAR) ? XGU_TEXTURE_FILTER_LINEAR : XGU_TEXTURE_FILTER_NEAREST;
+    push_reserve(1 + batch_count + 2 + 2);
+    if (batch_count) {
+        p = push_command(p, method, batch_count);
+        SDL_memcpy(p, batch, batch_count * sizeof(uint32_t));
+        p += batch_count;
+    }
+    // An odd index left over from 16-bit packing is sent on its own
+    if (has_pending) {
+        p = push_command_parameter(p, NV097_ARRAY_ELEMENT32, pending);
+    }
+    p = xgu_end(p);
+}
 
-        const XguTextureAddress texture_address_mode_u =
-            (cmd->data.draw.texture_address_mode_u == SDL_TEXTURE_ADDRESS_CLAMP) ? XGU_CLAMP_TO_EDGE : XGU_WRAP;
+static void draw_arrays(XguPrimitiveType mode, size_t count)
+{
+    push_reserve(2);
+    p = xgu_begin(p, mode);
+
+    // Each NV097_DRAW_ARRAYS draws at most 256 vertices
+    for (size_t start = 0; start < count; start += 256) {
+        const size_t batch_count = SDL_min(count - start, 256);
+        push_reserve(2);
+        p = push_command_parameter(p, NV097_DRAW_ARRAYS,
+                                   XGU_MASK(NV097_DRAW_ARRAYS_COUNT, batch_count - 1) |
+                                       XGU_MASK(NV097_DRAW_ARRAYS_START_INDEX, start));
+    }
 
-        const XguTextureAddress texture_address_mode_v =
-            (cmd->data.draw.texture_address_mode_v == SDL_TEXTURE_ADDRESS_CLAMP) ? XGU_CLAMP_TO_EDGE : XGU_WRAP;
+    push_reserve(2);
+    p = xgu_end(p);
+}
 
-        const int texture_index = 0;
-        if (render_data->active_texture != xgu_texture) {
-            p = pb_begin();
-            p = xgu_set_texture_offset(p, texture_index, xgu_texture->data_physical_address);
-            p = xgu_set_texture_format(p, texture_index, 2, false, XGU_SOURCE_COLOR, 2, xgu_texture->format, 1,
-                                       __builtin_ctz(xgu_texture->data_width), __builtin_ctz(xgu_texture->data_height), 0);
-            p = xgu_set_texture_control0(p, texture_index, true, 0, 0);
-            p = xgu_set_texture_control1(p, texture_index, xgu_texture->pitch);
-            p = xgu_set_texture_image_rect(p, texture_index, xgu_texture->tex_width, xgu_texture->tex_height);
-            pb_end(p);
-            render_data->active_texture = xgu_texture;
-            // Invalidate these so they are refreshed
-            xgu_texture->filter = -1;
-            xgu_texture->mode_u = -1;
-            xgu_texture->mode_v = -1;
-        }
-
-        // The texture could be the same but the filter could have changed
-        if (render_data->active_texture->filter != texture_filter) {
-            p = pb_begin();
-            p = xgu_set_texture_filter(p, texture_index, 0, XGU_TEXTURE_CONVOLUTION_GAUSSIAN,
-                                       texture_filter, texture_filter, false, false, false, false);
-            pb_end(p);
-            xgu_texture->filter = texture_filter;
-        }
-
-        // The texture could be the same but the address mode could have changed
-        if (render_data->active_texture->mode_u != texture_address_mode_u ||
-            render_data->active_texture->mode_v != texture_address_mode_v) {
-            p = pb_begin();
-            p = xgu_set_texture_address(p, texture_index,
-                                        texture_address_mode_u, (texture_address_mode_u == XGU_WRAP),
-                                        texture_address_mode_v, (texture_address_mode_v == XGU_WRAP),
-                                        XGU_CLAMP_TO_EDGE, false, false);
-            pb_end(p);
-            xgu_texture->mode_u = texture_address_mode_u;
-            xgu_texture->mode_v = texture_address_mode_v;
+// Pushes the vertices themselves with NV097_INLINE_ARRAY. Each vertex is its attributes back to back in attribute
+// order, which is how the vertex structs are laid out. Indexed geometry is expanded, these draws are small.
+static void draw_inline(XguPrimitiveType mode, const uint8_t *vertices, size_t stride, size_t count,
+                        const uint32_t *index_stream, size_t index_stream_length)
+{
+    const size_t vertex_dwords = stride / sizeof(uint32_t);
+    const size_t batch_max = ((SDL_XGU_PUSH_BLOCK_SIZE - 1) / vertex_dwords) * vertex_dwords;
+    uint32_t *header = NULL;
+    size_t batch_count = 0;
+
+    assert((stride % sizeof(uint32_t)) == 0);
+
+    push_reserve(2);
+    p = xgu_begin(p, mode);
+
+    if (index_stream == NULL) {
+        while (count > 0) {
+            const size_t batch_vertices = SDL_min(count, batch_max / vertex_dwords);
+            push_reserve(1 + batch_vertices * vertex_dwords);
+            p = push_command(p, NV097_INLINE_ARRAY, batch_vertices * vertex_dwords);
+            SDL_memcpy(p, vertices, batch_vertices * stride);
+            p += batch_vertices * vertex_dwords;
+            vertices += batch_vertices * stride;
+            count -= batch_vertices;
         }
-
-        xgu_vertex_textured_t *xgu_verts = (xgu_vertex_textured_t *)vertices;
-        xgux_set_attrib_pointer(XGU_VERTEX_ARRAY, XGU_FLOAT,
-                                SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_textured_t), xgu_verts->pos);
-        xgux_set_attrib_pointer(XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
-                                SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_textured_t), xgu_verts->color);
-        xgux_set_attrib_pointer(XGU_TEXCOORD0_ARRAY, XGU_FLOAT,
-                                SDL_arraysize(xgu_verts->tex), sizeof(xgu_vertex_textured_t), xgu_verts->tex);
-        xgux_draw_arrays(XGU_TRIANGLES, 0, count);
     } else {
-
-        if (render_data->texture_shader_active == 1) {
-            p = pb_begin();
-            unlit_combiner_apply();
-            pb_end(p);
-            render_data->texture_shader_active = 0;
+        const uint32_t *end = index_stream + index_stream_length;
+        uint32_t base = 0;
+        while (index_stream < end) {
+            const uint32_t entry_index_count = index_stream[INDEX_HEADER_INDEX_COUNT];
+            const uint32_t *indices = &index_stream[INDEX_HEADER_SIZE];
+
+            for (uint32_t i = 0; i < entry_index_count; i++) {
+                // The method header is written once the number of vertices in the batch is known
+                if (header && batch_count == batch_max) {
+                    push_command(header, NV097_INLINE_ARRAY, batch_count);
+                    header = NULL;
+                }
+                if (header == NULL) {
+                    push_reserve(1 + batch_max);
+                    header = p++;
+                    batch_count = 0;
+                }
+                SDL_memcpy(p, vertices + (indices[i] + base) * stride, stride);
+                p += vertex_dwords;
+                batch_count += vertex_dwords;
+            }
+            base += index_stream[INDEX_HEADER_VERTEX_COUNT];
+            index_stream += INDEX_HEADER_SIZE + entry_index_count;
+        }
+        if (header) {
+            push_command(header, NV097_INLINE_ARRAY, batch_count);
         }
-
-        xgu_vertex_t *xgu_verts = (xgu_vertex_t *)vertices;
-        xgux_set_attrib_pointer(XGU_VERTEX_ARRAY, XGU_FLOAT,
-                                SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_t), xgu_verts->pos);
-        xgux_set_attrib_pointer(XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
-                                SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_t), xgu_verts->color);
-        xgux_set_attrib_pointer(XGU_TEXCOORD0_ARRAY, XGU_FLOAT, 0, 0, NULL);
-        xgux_draw_arrays(XGU_TRIANGLES, 0, count);
+    }
+
+    push_reserve(2);
+    p = xgu_end(p);
+}
+
+// Records that the texture is read by the frame being built, so it isn't freed or overwritten while in flight
+static void texture_mark_used(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture, int palette_index)
+{
+    xgu_texture->buffers[xgu_texture->buffer_index].last_used_frame = render_data->frame_serial;
+    if (xgu_texture->atlas_page) {
+        xgu_texture->atlas_page->last_used_frame = render_data->frame_serial;
+    }
+    if (xgu_texture->palettes) {
+        xgu_texture->palettes[palette_index].last_used_frame = render_data->frame_serial;
+    }
+    if (render_data->recording) {
+        bundle_add_texture(render_data->recording, xgu_texture, palette_index);
+    }
+}
+
+// Same as xgux_set_attrib_pointer but goes through the state shadow. The format of each array rarely changes between draws.
+// data is NULL for disabled arrays and inline vertices, neither of which read the offset, so it is left alone.
+static void set_attrib_pointer(xgu_render_data_t *render_data, XguVertexArray index, XguVertexArrayType format,
+                               unsigned int size, unsigned int stride, const void *data)
+{
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    s = xgu_set_vertex_data_array_format(s, index, format, size, stride);
+    if (data) {
+        s = xgu_set_vertex_data_array_offset(s, index, (uint32_t)(uintptr_t)data & 0x03ffffff);
+    }
+    state_push(render_data, XGU_STATE_VERTEX_ARRAY, state, s);
+}
+
+static inline bool vertices_are_inline(const xgu_render_data_t *render_data, const void *vertices)
+{
+    const uint8_t *v = (const uint8_t *)vertices;
+    return render_data->inline_vertices && v >= render_data->inline_vertices &&
+           v < render_data->inline_vertices + SDL_XGU_INLINE_BUFFER_SIZE;
+}
+
+// The address of a vertex attribute in the arena, or NULL for inline vertices
+#define ATTRIB_DATA(verts, member) ((verts) ? (const void *)(verts)->member : NULL)
+
+// Texture units 1 and 2 read the same texture coordinates as unit 0 when they sample the chroma planes of a planar
+// YUV texture. texture_planes is 0 for untextured draws.
+static void set_texcoord_pointers(xgu_render_data_t *render_data, XguVertexArrayType format, unsigned int size,
+                                  unsigned int stride, const void *data, int texture_planes)
+{
+    for (int i = 0; i < 3; i++) {
+        if (i < texture_planes) {
+            set_attrib_pointer(render_data, (XguVertexArray)(XGU_TEXCOORD0_ARRAY + i), format, size, stride, data);
+        } else {
+            set_attrib_pointer(render_data, (XguVertexArray)(XGU_TEXCOORD0_ARRAY + i), XGU_FLOAT, 0, 0, NULL);
+        }
+    }
+}
+
+static void set_geometry_attrib_pointers(xgu_render_data_t *render_data, enum vertex_format format, void *vertices,
+                                         int texture_planes)
+{
+    switch (format) {
+    case VERTEX_FORMAT_COLOR:
+    {
+        xgu_vertex_t *xgu_verts = (xgu_vertex_t *)vertices;
+        set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_FLOAT,
+                           SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_t), ATTRIB_DATA(xgu_verts, pos));
+        set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
+                           SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_t), ATTRIB_DATA(xgu_verts, color));
+        set_texcoord_pointers(render_data, XGU_FLOAT, 0, 0, NULL, 0);
+        break;
+    }
+    case VERTEX_FORMAT_TEXTURED:
+    {
+        xgu_vertex_textured_t *xgu_verts = (xgu_vertex_textured_t *)vertices;
+        set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_FLOAT,
+                           SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_textured_t), ATTRIB_DATA(xgu_verts, pos));
+        set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
+                           SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_textured_t), ATTRIB_DATA(xgu_verts, color));
+        set_texcoord_pointers(render_data, XGU_FLOAT, SDL_arraysize(xgu_verts->tex), sizeof(xgu_vertex_textured_t),
+                              ATTRIB_DATA(xgu_verts, tex), texture_planes);
+        break;
+    }
+    // XGU_SHORT is the unnormalised 16-bit format so the values are used as is
+    case VERTEX_FORMAT_COLOR_COMPACT:
+    {
+        xgu_vertex_compact_t *xgu_verts = (xgu_vertex_compact_t *)vertices;
+        set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_SHORT,
+                           SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_compact_t), ATTRIB_DATA(xgu_verts, pos));
+        set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
+                           SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_compact_t), ATTRIB_DATA(xgu_verts, color));
+        set_texcoord_pointers(render_data, XGU_FLOAT, 0, 0, NULL, 0);
+        break;
+    }
+    case VERTEX_FORMAT_TEXTURED_COMPACT:
+    {
+        xgu_vertex_textured_compact_t *xgu_verts = (xgu_vertex_textured_compact_t *)vertices;
+        set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_SHORT,
+                           SDL_arraysize(xgu_verts->pos), sizeof(xgu_vertex_textured_compact_t), ATTRIB_DATA(xgu_verts, pos));
+        set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_UNSIGNED_BYTE_OGL,
+                           SDL_arraysize(xgu_verts->color), sizeof(xgu_vertex_textured_compact_t), ATTRIB_DATA(xgu_verts, color));
+        set_texcoord_pointers(render_data, XGU_SHORT, SDL_arraysize(xgu_verts->tex), sizeof(xgu_vertex_textured_compact_t),
+                              ATTRIB_DATA(xgu_verts, tex), texture_planes);
+        break;
+    }
+    }
+}
+
+#undef ATTRIB_DATA
+
+// Register state to sample one plane of a texture on texture unit texture_index
+static uint32_t *texture_unit_apply(uint32_t *s, int texture_index, const uint8_t *physical_address, XguTexFormatColor format,
+                                    int data_width, int data_height, int pitch, int width, int height,
+                                    XguTexFilter filter, XguTextureAddress address_u, XguTextureAddress address_v)
+{
+    s = xgu_set_texture_offset(s, texture_index, physical_address);
+    s = xgu_set_texture_format(s, texture_index, 2, false, XGU_SOURCE_COLOR, 2, format, 1,
+                               __builtin_ctz(data_width), __builtin_ctz(data_height), 0);
+    s = xgu_set_texture_control0(s, texture_index, true, 0, 0);
+    s = xgu_set_texture_control1(s, texture_index, pitch);
+    s = xgu_set_texture_image_rect(s, texture_index, width, height);
+    s = xgu_set_texture_filter(s, texture_index, 0, XGU_TEXTURE_CONVOLUTION_GAUSSIAN,
+                               filter, filter, false, false, false, false);
+    s = xgu_set_texture_address(s, texture_index,
+                                address_u, (address_u == XGU_WRAP),
+                                address_v, (address_v == XGU_WRAP),
+                                XGU_CLAMP_TO_EDGE, false, false);
+    return s;
+}
+
+static bool XBOX_RenderGeometry(SDL_Renderer *renderer, void *vertices, SDL_RenderCommand *cmd, size_t count,
+                                enum vertex_format format, XguPrimitiveType primitive, int palette_index,
+                                const uint32_t *index_stream, size_t index_stream_length)
+{
+    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+
+    set_blend_mode(renderer, cmd->data.draw.blend);
+
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    if (cmd->data.draw.texture) {
+        xgu_texture_t *xgu_texture = (xgu_texture_t *)cmd->data.draw.texture->internal;
+
+        // Nearest filtering is used for nearest and pixelart scale modes
+        const XguTexFilter texture_filter =
+            (cmd->data.draw.texture_scale_mode == SDL_SCALEMODE_LINEAR) ? XGU_TEXTURE_FILTER_LINEAR : XGU_TEXTURE_FILTER_NEAREST;
+
+        const XguTextureAddress texture_address_mode_u =
+            (cmd->data.draw.texture_address_mode_u == SDL_TEXTURE_ADDRESS_CLAMP || xgu_texture->atlas_page) ? XGU_CLAMP_TO_EDGE : XGU_WRAP;
+
+        const XguTextureAddress texture_address_mode_v =
+            (cmd->data.draw.texture_address_mode_v == SDL_TEXTURE_ADDRESS_CLAMP || xgu_texture->atlas_page) ? XGU_CLAMP_TO_EDGE : XGU_WRAP;
+
+        const int texture_index = 0;
+        texture_mark_used(render_data, xgu_texture, palette_index);
+
+        if (xgu_texture->planes > 1) {
+            s = yuv_combiner_apply(s, xgu_texture);
+            state_push(render_data, XGU_STATE_SHADER, state, s);
+            for (int stage = 0; stage < SDL_XGU_YUV_COMBINER_STAGES; stage++) {
+                s = state;
+                s = yuv_combiner_stage_apply(s, xgu_texture, stage);
+                state_push(render_data, XGU_STATE_SHADER, state, s);
+            }
+        } else {
+            s = texture_combiner_apply(s);
+            state_push(render_data, XGU_STATE_SHADER, state, s);
+        }
+
+        s = state;
+        s = texture_unit_apply(s, texture_index, xgu_texture->data_physical_address, xgu_texture->format,
+                               xgu_texture->data_width, xgu_texture->data_height, xgu_texture->pitch,
+                               xgu_texture->tex_width, xgu_texture->tex_height,
+                               texture_filter, texture_address_mode_u, texture_address_mode_v);
+        if (xgu_texture->palettes) {
+            // The palette is read through the same DMA context as the texture data
+            const uint32_t palette_offset = (uint32_t)(uintptr_t)xgu_texture->palettes[palette_index].physical_address;
+            s = pb_push1(s, NV097_SET_TEXTURE_PALETTE + texture_index * 64,
+                         (palette_offset & NV097_SET_TEXTURE_PALETTE_PALETTE_OFFSET) |
+                             NV097_SET_TEXTURE_PALETTE_CONTEXT_DMA_B | NV097_SET_TEXTURE_PALETTE_LENGTH_256);
+        }
+        state_push(render_data, XGU_STATE_TEXTURE, state, s);
+
+        // The chroma planes are sampled by texture units 1 and 2, whose texture matrix halves the coordinates
+        for (int plane = 1; plane < xgu_texture->planes; plane++) {
+            const int chroma_width = (xgu_texture->tex_width + 1) / 2;
+            const int chroma_height = (xgu_texture->tex_height + 1) / 2;
+            s = state;
+            s = texture_unit_apply(s, plane, xgu_texture->data_physical_address + xgu_texture->chroma_offsets[plane - 1],
+                                   (xgu_texture->planes == 2) ? XGU_TEXTURE_FORMAT_G8B8 : XGU_TEXTURE_FORMAT_Y8,
+                                   chroma_width, chroma_height, xgu_texture->chroma_pitch, chroma_width, chroma_height,
+                                   texture_filter, texture_address_mode_u, texture_address_mode_v);
+            state_push(render_data, XGU_STATE_TEXTURE, state, s);
+        }
+    } else {
+        s = unlit_combiner_apply(s);
+        state_push(render_data, XGU_STATE_SHADER, state, s);
+    }
+
+    const int texture_planes = (cmd->data.draw.texture) ? ((xgu_texture_t *)cmd->data.draw.texture->internal)->planes : 0;
+    render_data->stats.draw_calls++;
+    render_data->render_target_written = true;
+    if (vertices_are_inline(render_data, vertices)) {
+        set_geometry_attrib_pointers(render_data, format, NULL, texture_planes);
+        draw_inline(primitive, vertices, vertex_format_stride(format), count, index_stream, index_stream_length);
+    } else if (index_stream) {
+        set_geometry_attrib_pointers(render_data, format, vertices, texture_planes);
+        draw_elements(primitive, index_stream, index_stream_length, count);
+    } else {
+        set_geometry_attrib_pointers(render_data, format, vertices, texture_planes);
+        draw_arrays(primitive, count);
     }
 
     return true;
@@ -635,11 +1547,18 @@ static bool XBOX_RenderPoints(SDL_Renderer *renderer, void *vertices, SDL_Render
     set_blend_mode(renderer, cmd->data.draw.blend);
 
     xgu_point_t *xgu_verts = (xgu_point_t *)vertices;
-    xgux_set_attrib_pointer(XGU_VERTEX_ARRAY, XGU_FLOAT,
-                            SDL_arraysize(xgu_verts->pos), sizeof(xgu_point_t), xgu_verts->pos);
-    xgux_set_attrib_pointer(XGU_COLOR_ARRAY, XGU_FLOAT, 0, 0, NULL);
-    xgux_set_attrib_pointer(XGU_TEXCOORD0_ARRAY, XGU_FLOAT, 0, 0, NULL);
-    xgux_draw_arrays(XGU_POINTS, 0, count);
+    const bool inline_vertices = vertices_are_inline(render_data, vertices);
+    set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_FLOAT,
+                       SDL_arraysize(xgu_verts->pos), sizeof(xgu_point_t), (inline_vertices) ? NULL : xgu_verts->pos);
+    set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_FLOAT, 0, 0, NULL);
+    set_texcoord_pointers(render_data, XGU_FLOAT, 0, 0, NULL, 0);
+    render_data->stats.draw_calls++;
+    render_data->render_target_written = true;
+    if (inline_vertices) {
+        draw_inline(XGU_POINTS, vertices, sizeof(xgu_point_t), count, NULL, 0);
+    } else {
+        draw_arrays(XGU_POINTS, count);
+    }
 
     return true;
 }
@@ -652,25 +1571,98 @@ static bool XBOX_RenderLines(SDL_Renderer *renderer, void *vertices, SDL_RenderC
     set_blend_mode(renderer, cmd->data.draw.blend);
 
     xgu_point_t *xgu_verts = (xgu_point_t *)vertices;
-    xgux_set_attrib_pointer(XGU_VERTEX_ARRAY, XGU_FLOAT,
-                            SDL_arraysize(xgu_verts->pos), sizeof(xgu_point_t), xgu_verts->pos);
-    xgux_set_attrib_pointer(XGU_COLOR_ARRAY, XGU_FLOAT, 0, 0, NULL);
-    xgux_set_attrib_pointer(XGU_TEXCOORD0_ARRAY, XGU_FLOAT, 0, 0, NULL);
-    xgux_draw_arrays(XGU_LINE_STRIP, 0, count);
+    const bool inline_vertices = vertices_are_inline(render_data, vertices);
+    set_attrib_pointer(render_data, XGU_VERTEX_ARRAY, XGU_FLOAT,
+                       SDL_arraysize(xgu_verts->pos), sizeof(xgu_point_t), (inline_vertices) ? NULL : xgu_verts->pos);
+    set_attrib_pointer(render_data, XGU_COLOR_ARRAY, XGU_FLOAT, 0, 0, NULL);
+    set_texcoord_pointers(render_data, XGU_FLOAT, 0, 0, NULL, 0);
+    render_data->stats.draw_calls++;
+    render_data->render_target_written = true;
+    if (inline_vertices) {
+        draw_inline(XGU_LINE_STRIP, vertices, sizeof(xgu_point_t), count, NULL, 0);
+    } else {
+        draw_arrays(XGU_LINE_STRIP, count);
+    }
 
     return true;
 }
 
+// Two geometry commands can be drawn together if they share all of the state used in XBOX_RenderGeometry
+// and the vertices of the second command start exactly where the vertices of the first one end.
+// True if both textures are drawn from the same memory, which is the case for textures on the same atlas page
+static bool textures_share_storage(const SDL_Texture *a, const SDL_Texture *b)
+{
+    if (a == b) {
+        return true;
+    }
+    if (a == NULL || b == NULL) {
+        return false;
+    }
+    const xgu_atlas_page_t *page = ((const xgu_texture_t *)a->internal)->atlas_page;
+    return page != NULL && page == ((const xgu_texture_t *)b->internal)->atlas_page;
+}
+
+static bool can_merge_geometry(const SDL_RenderCommand *cmd, const SDL_RenderCommand *next, size_t end_offset)
+{
+    return next->command == SDL_RENDERCMD_GEOMETRY &&
+           textures_share_storage(next->data.draw.texture, cmd->data.draw.texture) &&
+           next->data.draw.blend == cmd->data.draw.blend &&
+           next->data.draw.texture_scale_mode == cmd->data.draw.texture_scale_mode &&
+           next->data.draw.texture_address_mode_u == cmd->data.draw.texture_address_mode_u &&
+           next->data.draw.texture_address_mode_v == cmd->data.draw.texture_address_mode_v &&
+           next->data.draw.first == end_offset;
+}
+
+// SDL calls this when the application may have changed GPU state behind the renderer's back, for example with
+// raw pbkit code between SDL_FlushRenderer and the next SDL render call.
 static void XBOX_InvalidateCachedState(SDL_Renderer *renderer)
 {
-    (void)renderer;
+    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    state_invalidate(render_data);
+}
+
+static uint16_t capture_command_tag(SDL_RenderCommandType command)
+{
+    switch (command) {
+    case SDL_RENDERCMD_SETVIEWPORT:
+        return XGU_CAPTURE_TAG_SET_VIEWPORT;
+    case SDL_RENDERCMD_SETCLIPRECT:
+        return XGU_CAPTURE_TAG_SET_CLIP_RECT;
+    case SDL_RENDERCMD_SETDRAWCOLOR:
+        return XGU_CAPTURE_TAG_SET_DRAW_COLOR;
+    case SDL_RENDERCMD_CLEAR:
+        return XGU_CAPTURE_TAG_CLEAR;
+    case SDL_RENDERCMD_DRAW_POINTS:
+        return XGU_CAPTURE_TAG_DRAW_POINTS;
+    case SDL_RENDERCMD_DRAW_LINES:
+        return XGU_CAPTURE_TAG_DRAW_LINES;
+    case SDL_RENDERCMD_GEOMETRY:
+        return XGU_CAPTURE_TAG_GEOMETRY;
+    default:
+        return XGU_CAPTURE_TAG_OTHER;
+    }
+}
+
+// The vertices of a command are in the vertex arena, not SDL's vertex buffer. cmd->data.draw.first holds their address.
+static inline void *command_vertices(const SDL_RenderCommand *cmd)
+{
+    return (void *)(uintptr_t)cmd->data.draw.first;
 }
 
 static bool XBOX_RunCommandQueue(SDL_Renderer *renderer, SDL_RenderCommand *cmd, void *vertices, size_t vertsize)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    const Uint64 start_ns = SDL_GetTicksNS();
+    (void)vertices;
     (void)vertsize;
+    push_bundle = render_data->recording;
+    if (render_data->active_render_target && render_data->recording == NULL) {
+        readbacks_settle(render_data, render_data->active_render_target);
+    }
     while (cmd) {
+        if (capture_io) {
+            capture_set_tag(capture_command_tag(cmd->command));
+        }
         switch (cmd->command) {
         case SDL_RENDERCMD_SETVIEWPORT:
         {
@@ -694,17 +1686,48 @@ static bool XBOX_RunCommandQueue(SDL_Renderer *renderer, SDL_RenderCommand *cmd,
         }
         case SDL_RENDERCMD_DRAW_POINTS:
         {
-            XBOX_RenderPoints(renderer, (uint8_t *)vertices + cmd->data.draw.first, cmd);
+            XBOX_RenderPoints(renderer, command_vertices(cmd), cmd);
             break;
         }
         case SDL_RENDERCMD_DRAW_LINES:
         {
-            XBOX_RenderLines(renderer, (uint8_t *)vertices + cmd->data.draw.first, cmd);
+            XBOX_RenderLines(renderer, command_vertices(cmd), cmd);
             break;
         }
         case SDL_RENDERCMD_GEOMETRY:
         {
-            XBOX_RenderGeometry(renderer, (uint8_t *)vertices + cmd->data.draw.first, cmd);
+            const uint32_t *index_stream = &render_data->index_stream[render_data->index_stream_read];
+            const bool indexed = index_stream[INDEX_HEADER_INDEX_COUNT] != 0;
+            const XguPrimitiveType primitive = (XguPrimitiveType)index_stream[INDEX_HEADER_PRIMITIVE];
+            const enum vertex_format format = (enum vertex_format)index_stream[INDEX_HEADER_VERTEX_FORMAT];
+            const int palette_index = (int)index_stream[INDEX_HEADER_PALETTE];
+            const size_t stride = vertex_format_stride(format);
+            size_t index_stream_length = INDEX_HEADER_SIZE + index_stream[INDEX_HEADER_INDEX_COUNT];
+            size_t count = cmd->data.draw.count;
+            SDL_RenderCommand *first_cmd = cmd;
+
+            assert(index_stream[INDEX_HEADER_VERTEX_COUNT] == cmd->data.draw.count);
+
+            // Absorb the following commands into this draw for as long as they are compatible
+            while (cmd->next && can_merge_geometry(first_cmd, cmd->next, first_cmd->data.draw.first + count * stride)) {
+                const uint32_t *next_entry = &index_stream[index_stream_length];
+                if ((next_entry[INDEX_HEADER_INDEX_COUNT] != 0) != indexed || next_entry[INDEX_HEADER_PRIMITIVE] != primitive ||
+                    next_entry[INDEX_HEADER_VERTEX_FORMAT] != format || next_entry[INDEX_HEADER_PALETTE] != palette_index) {
+                    break;
+                }
+                cmd = cmd->next;
+                count += cmd->data.draw.count;
+                // Only the first texture of the draw is bound, the others still need to be kept alive
+                if (cmd->data.draw.texture != first_cmd->data.draw.texture) {
+                    texture_mark_used(render_data, (xgu_texture_t *)cmd->data.draw.texture->internal, palette_index);
+                }
+                index_stream_length += INDEX_HEADER_SIZE + next_entry[INDEX_HEADER_INDEX_COUNT];
+                render_data->stats.merged_draws++;
+            }
+
+            XBOX_RenderGeometry(renderer, command_vertices(first_cmd), first_cmd, count,
+                                format, primitive, palette_index, (indexed) ? index_stream : NULL, index_stream_length);
+            render_data->index_stream_read += index_stream_length;
             break;
         }
         // SDL should use XBOX_QueueGeometry instead of these commands.
@@ -718,78 +1741,181 @@ static bool XBOX_RunCommandQueue(SDL_Renderer *renderer, SDL_RenderCommand *cmd,
         cmd = cmd->next;
     }
 
+    push_flush();
+    push_bundle = NULL;
+    capture_set_tag(XGU_CAPTURE_TAG_OTHER);
+
+    // All queued geometry has been drawn so the index stream and inline vertices can be reused
+    render_data->index_stream_length = 0;
+    render_data->index_stream_read = 0;
+    render_data->inline_vertices_offset = 0;
+
+    render_data->stats.command_queue_ns += SDL_GetTicksNS() - start_ns;
     return true;
 }
 
 static SDL_Surface *XBOX_RenderReadPixels(SDL_Renderer *renderer, const SDL_Rect *rect)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    const xgu_texture_t *target = renderer->target ? (const xgu_texture_t *)renderer->target->internal : NULL;
     SDL_PixelFormat format = renderer->target ? renderer->target->format : SDL_PIXELFORMAT_ARGB8888;
 
-    SDL_Surface *surface = SDL_CreateSurface(rect->w, rect->h, format);
-    if (surface == NULL) {
-        return NULL;
-    }
-    const SDL_PixelFormat dst_format = surface->format;
-    const int dst_bytes_per_pixel = SDL_BYTESPERPIXEL(dst_format);
-    const int dst_pitch = surface->pitch;
-    uint8_t *dst8 = surface->pixels;
-
     // Ensure the back buffer is fully renderered before reading pixels
-    p = pb_begin();
+    p = push_begin();
     p = pb_push1(p, NV097_NO_OPERATION, 0);
     p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-    pb_end(p);
+    push_end(p);
 
     while (pb_busy()) {
         Sleep(0);
     }
 
-    XVideoFlushFB();
+    return read_target_pixels(target, pb_back_buffer(), format, rect);
+}
+
+// Copies rect from a render target texture, or from back_buffer if target is NULL, into a new surface of
+// the given format. The GPU must have finished rendering to the source.
+static SDL_Surface *read_target_pixels(const xgu_texture_t *target, const uint8_t *back_buffer,
+                                       SDL_PixelFormat format, const SDL_Rect *rect)
+{
+    SDL_Surface *surface = SDL_CreateSurface(rect->w, rect->h, format);
+    if (surface == NULL) {
+        return NULL;
+    }
 
-    // Get the back buffer as the source
-    VIDEO_MODE vm = XVideoGetMode();
     SDL_PixelFormat src_format;
-    if (vm.bpp == 15) {
-        src_format = SDL_PIXELFORMAT_XRGB1555;
-    } else if (vm.bpp == 16) {
-        src_format = SDL_PIXELFORMAT_RGB565;
+    int src_pitch;
+    const uint8_t *src8;
+    if (target) {
+        src_format = format;
+        src_pitch = target->pitch;
+        src8 = target->data;
     } else {
-        src_format = SDL_PIXELFORMAT_ARGB8888;
+        XVideoFlushFB();
+
+        // Get the back buffer as the source
+        VIDEO_MODE vm = XVideoGetMode();
+        if (vm.bpp == 15) {
+            src_format = SDL_PIXELFORMAT_XRGB1555;
+        } else if (vm.bpp == 16) {
+            src_format = SDL_PIXELFORMAT_RGB565;
+        } else {
+            src_format = SDL_PIXELFORMAT_ARGB8888;
+        }
+        src_pitch = vm.width * ((vm.bpp + 7) / 8);
+        src8 = back_buffer;
     }
-    const int src_pitch = vm.width * ((vm.bpp + 7) / 8);
-    const uint8_t *src8 = (const uint8_t *)pb_back_buffer();
 
-    // Now copy the back buffer pixels to the surface
+    // Now copy the source pixels to the surface
     SDL_ConvertPixels(rect->w, rect->h,
-                      src_format, &src8[rect->y * src_pitch + rect->x * dst_bytes_per_pixel], src_pitch,
-                      dst_format, &dst8[rect->y * dst_pitch + rect->x * dst_bytes_per_pixel], dst_pitch);
+                      src_format, &src8[rect->y * src_pitch + rect->x * SDL_BYTESPERPIXEL(src_format)], src_pitch,
+                      surface->format, surface->pixels, surface->pitch);
 
     return surface;
 }
 
+// Finishes the pending asynchronous readbacks whose frame has been rendered and hands the surfaces to their
+// callbacks. If idle is true the caller has waited for the GPU to finish all work, and every readback from
+// source is finished, or every readback if source is NULL.
+static void readbacks_complete(xgu_render_data_t *render_data, const xgu_texture_t *source, bool idle)
+{
+    int remaining = 0;
+    for (int i = 0; i < render_data->readback_count; i++) {
+        const xgu_readback_t readback = render_data->readbacks[i];
+        const bool finished = (idle) ? (source == NULL || readback.source == source) : !frame_in_flight(render_data, readback.frame);
+        if (!finished) {
+            render_data->readbacks[remaining++] = readback;
+            continue;
+        }
+        readback.callback(readback.userdata,
+                          read_target_pixels(readback.source, readback.back_buffer, readback.format, &readback.rect));
+    }
+    render_data->readback_count = remaining;
+}
+
+// Finishes the readbacks from a render target texture that were queued in earlier frames, before the texture is
+// written again. Only then does the CPU wait for the GPU, and only for the frame of the oldest such readback.
+// Readbacks queued in the current frame include what is drawn later in the frame, so they stay pending.
+static void readbacks_settle(xgu_render_data_t *render_data, const xgu_texture_t *source)
+{
+    bool waited = false;
+    for (int i = 0; i < render_data->readback_count; i++) {
+        const xgu_readback_t *readback = &render_data->readbacks[i];
+        if (readback->source == source && readback->frame != render_data->frame_serial) {
+            wait_for_frame(render_data, readback->frame);
+            waited = true;
+        }
+    }
+    if (waited) {
+        readbacks_complete(render_data, NULL, false);
+    }
+}
+
 static bool XBOX_RenderPresent(SDL_Renderer *renderer)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
 
     calculate_fps(FPS_STAGE_DISPLAY);
-
-    while (pb_busy()) {
-        Sleep(0);
+    stats_publish(renderer);
+
+    SDL_PropertiesID props = SDL_GetRendererProperties(renderer);
+
+    contiguous_heap_stats_t heap_stats;
+    contiguous_heap_get_stats(CONTIGUOUS_HEAP_WRITECOMBINE, &heap_stats);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_HEAP_BYTES_USED_NUMBER, heap_stats.bytes_in_use);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_HEAP_BYTES_PEAK_NUMBER, heap_stats.peak_bytes_in_use);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_HEAP_FRAGMENTATION_NUMBER, heap_stats.fragmentation);
+
+    // The GPU writes the frame serial to the fence once everything before it has been rendered
+    const uint32_t frame = render_data->frame_serial;
+    capture_set_tag(XGU_CAPTURE_TAG_PRESENT);
+    p = push_begin();
+    p = pb_push1(p, NV097_SET_SEMAPHORE_OFFSET, 0);
+    p = pb_push1(p, NV097_BACK_END_WRITE_SEMAPHORE_RELEASE, frame);
+    push_end(p);
+    capture_set_tag(XGU_CAPTURE_TAG_OTHER);
+    if (capture_io) {
+        capture_frame++;
+        if (--capture_frames_left == 0) {
+            capture_stop();
+        }
+    } else if (capture_pending_io) {
+        capture_io = capture_pending_io;
+        capture_pending_io = NULL;
     }
 
-    while (pb_finished()) {
-        Sleep(0);
+    // Every wait for the display or the GPU in present is between here and present_wait_ns being set
+    const Uint64 wait_start = SDL_GetTicksNS();
+
+    // pbkit won't queue another buffer swap while all the back buffers are waiting to be shown. The wait ends
+    // with a flip, which pbkit only does on vblank.
+    Uint64 flip_ns = 0;
+    if (pb_finished()) {
+        while (pb_finished()) {
+            Sleep(0);
+        }
+        flip_ns = SDL_GetTicksNS();
     }
 
+    // Only wait for the GPU when the maximum number of frames are already in flight. This also guarantees
+    // that the vertex arena space and back buffer of the oldest frame are free to reuse.
+    wait_for_frame(render_data, frame - render_data->max_frames_in_flight);
+
+    render_data->present_wait_ns = SDL_GetTicksNS() - wait_start;
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_PRESENT_WAIT_NS_NUMBER, render_data->present_wait_ns);
+
     calculate_fps(FPS_STAGE_CALCULATE);
 
-    // It's probably better to wait on the vsync primitive here than it is to spin on pb_finished next loop
-    pb_wait_for_vbl();
+    readbacks_complete(render_data, NULL, false);
 
-    // A back buffer frame is rendered so clear the vertex allocation tracking for that frame.
-    render_data->frame_index = (render_data->frame_index + 1) % SDL_XGU_BUFFER_COUNT;
-    render_data->vertex_allocations[render_data->frame_index] = 0;
+    track_vblank(render_data, flip_ns);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_VBLANK_NS_NUMBER, render_data->last_vblank_ns);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_REFRESH_PERIOD_NS_NUMBER, render_data->refresh_period_ns);
+
+    arena_shrink(render_data);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_VERTEX_ARENA_HIGH_WATER_NUMBER, render_data->arena_high_water);
+
+    render_data->frame_serial++;
 
     // Reset for the next frame
     calculate_fps(FPS_STAGE_RESET);
@@ -801,10 +1927,31 @@ static bool XBOX_RenderPresent(SDL_Renderer *renderer)
 static void XBOX_DestroyRenderer(SDL_Renderer *renderer)
 {
     SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
-    pb_kill();
 
+    // Pending readbacks still get their callback
+    while (pb_busy()) {
+        Sleep(0);
+    }
+    readbacks_complete(render_data, NULL, true);
+    SDL_free(render_data->readbacks);
+
+    pb_kill();
+    capture_stop();
+
+    arena_destroy(render_data);
+    while (render_data->atlas_pages) {
+        xgu_atlas_page_t *page = render_data->atlas_pages;
+        render_data->atlas_pages = page->next;
+        contiguous_heap_free(page->data);
+        SDL_free(page);
+    }
+    if (render_data->recording) {
+        SDL_XGU_DestroyBundle(render_data->recording);
+    }
+    contiguous_heap_free((void *)render_data->fence);
+    SDL_free(render_data->index_stream);
+    SDL_free(render_data->inline_vertices);
     SDL_free(render_data);
-    MmFreeContiguousMemory(render_data->vertex_data);
 
     renderer->internal = NULL;
     renderer->vertex_data = NULL;
@@ -813,20 +1960,53 @@ static void XBOX_DestroyRenderer(SDL_Renderer *renderer)
 static bool XBOX_SetVSync(SDL_Renderer *renderer, const int vsync)
 {
     (void)renderer;
-    (void)vsync;
 
-    // pbkit always flips on vblank and it can't easily be disabled.
-    return SDL_Unsupported();
+    // pbkit flips to the next back buffer from its vblank interrupt and keeps its own record of which buffer is
+    // shown. Flipping immediately would mean writing the CRTC start address behind pbkit's back, so vsync 0 and
+    // adaptive vsync are not supported and every frame is shown on a vblank.
+    if (vsync != 1) {
+        return SDL_Unsupported();
+    }
+    return true;
+}
+
+// Keeps last_vblank_ns up to date without waiting for vblank. flip_ns is when present stopped waiting for a
+// back buffer to be flipped, or 0 if it didn't wait. Otherwise the last vblank is moved on by the number pbkit
+// has counted since.
+static void track_vblank(xgu_render_data_t *render_data, Uint64 flip_ns)
+{
+    const Uint64 now = SDL_GetTicksNS();
+    const uint32_t counter = pb_get_vbl_counter();
+    if (flip_ns) {
+        render_data->last_vblank_ns = flip_ns;
+    } else {
+        render_data->last_vblank_ns += (Uint64)(counter - render_data->vbl_counter) * render_data->refresh_period_ns;
+        // The refresh period is nominal, so don't let the estimate run ahead of the clock
+        render_data->last_vblank_ns = SDL_min(render_data->last_vblank_ns, now);
+    }
+    render_data->vbl_counter = counter;
 }
 
 static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_PropertiesID create_props)
 {
-    (void)create_props;
     xgu_render_data_t *render_data = (xgu_render_data_t *)SDL_calloc(1, sizeof(xgu_render_data_t));
     if (render_data == NULL) {
         return SDL_OutOfMemory();
     }
 
+    // Fewer frames in flight lowers input latency at the cost of less CPU and GPU overlap
+    Sint64 frames_in_flight = SDL_XGU_MAX_FRAMES_IN_FLIGHT;
+    const char *frames_in_flight_hint = SDL_GetHint(SDL_HINT_RENDER_XGU_FRAMES_IN_FLIGHT);
+    if (frames_in_flight_hint) {
+        frames_in_flight = SDL_atoi(frames_in_flight_hint);
+    }
+    frames_in_flight = SDL_GetNumberProperty(create_props, SDL_PROP_RENDERER_CREATE_XGU_FRAMES_IN_FLIGHT_NUMBER, frames_in_flight);
+    render_data->max_frames_in_flight = (int)SDL_clamp(frames_in_flight, 0, SDL_XGU_MAX_FRAMES_IN_FLIGHT);
+
+    render_data->atlas_enabled = SDL_GetHintBoolean(SDL_HINT_RENDER_XGU_TEXTURE_ATLAS, false);
+    render_data->atlas_enabled = SDL_GetBooleanProperty(create_props, SDL_PROP_RENDERER_CREATE_XGU_TEXTURE_ATLAS_BOOLEAN,
+                                                        render_data->atlas_enabled);
+
     const float m_identity[4 * 4] = {
         1.0f, 0.0f, 0.0f, 0.0f,
         0.0f, 1.0f, 0.0f, 0.0f,
@@ -838,6 +2018,12 @@ static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_
     const VIDEO_MODE vm = XVideoGetMode();
     set_surface_color_format(vm.bpp);
 
+    // Without the inline buffer every draw uses the vertex arena
+    if (SDL_XGU_INLINE_VERTEX_SIZE > 0) {
+        render_data->inline_vertices = (uint8_t *)SDL_malloc(SDL_XGU_INLINE_BUFFER_SIZE);
+    }
+    render_data->refresh_period_ns = SDL_NS_PER_SECOND / ((vm.refresh > 0) ? vm.refresh : 60);
+
     while (pb_init() < 0) {
         DbgPrint("[nxdk renderer] pbkit initialization failed, retrying...\n");
         Sleep(10);
@@ -849,9 +2035,9 @@ static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_
     pb_show_front_screen();
     pb_target_back_buffer();
 
-    p = pb_begin();
+    p = push_begin();
     combiner_init();
-    unlit_combiner_apply();
+    p = unlit_combiner_apply(p);
 
     p = xgu_set_blend_enable(p, true);
     p = xgu_set_depth_test_enable(p, false);
@@ -866,46 +2052,86 @@ static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_
     p = xgu_set_clear_rect_vertical(p, 0, pb_back_buffer_height());
     p = xgu_set_clear_rect_horizontal(p, 0, pb_back_buffer_width());
 
-    pb_end(p);
+    push_end(p);
 
     for (int i = 0; i < XGU_TEXTURE_COUNT; i++) {
-        p = pb_begin();
+        p = push_begin();
         p = xgu_set_texgen_s(p, i, XGU_TEXGEN_DISABLE);
         p = xgu_set_texgen_t(p, i, XGU_TEXGEN_DISABLE);
         p = xgu_set_texgen_r(p, i, XGU_TEXGEN_DISABLE);
         p = xgu_set_texgen_q(p, i, XGU_TEXGEN_DISABLE);
         p = xgu_set_texture_matrix_enable(p, i, false);
         p = xgu_set_texture_matrix(p, i, m_identity);
-        pb_end(p);
+        push_end(p);
+    }
+
+    // Texture units 1 and 2 are only used for the chroma planes of YUV textures, which are half the size of the Y plane
+    const float m_half[4 * 4] = {
+        0.5f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.5f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    for (int i = 1; i <= 2; i++) {
+        p = push_begin();
+        p = xgu_set_texture_matrix_enable(p, i, true);
+        p = xgu_set_texture_matrix(p, i, m_half);
+        push_end(p);
     }
 
     for (int i = 0; i < XGU_WEIGHT_COUNT; i++) {
-        p = pb_begin();
+        p = push_begin();
         p = xgu_set_model_view_matrix(p, i, m_identity);
         p = xgu_set_inverse_model_view_matrix(p, i, m_identity);
-        pb_end(p);
+        push_end(p);
     }
 
     for (int i = 0; i < XGU_ATTRIBUTE_COUNT; i++) {
         xgux_set_attrib_pointer(i, XGU_FLOAT, 0, 0, NULL);
     }
 
-    p = pb_begin();
+    p = push_begin();
     p = xgu_set_transform_execution_mode(p, XGU_FIXED, XGU_RANGE_MODE_PRIVATE);
     p = xgu_set_projection_matrix(p, m_identity);
     p = xgu_set_composite_matrix(p, m_identity);
     p = xgu_set_viewport_offset(p, 0.0f, 0.0f, 0.0f, 0.0f);
     p = xgu_set_viewport_scale(p, 1.0f, 1.0f, 1.0f, 1.0f);
     p = xgu_set_scissor_rect(p, false, 0, 0, pb_back_buffer_width(), pb_back_buffer_height());
-    pb_end(p);
+    push_end(p);
 
-    const int SDL_XGU_RENDER_TARGET_DMA_CHANNEL = 3;
-    pb_create_dma_ctx(SDL_XGU_RENDER_TARGET_DMA_CHANNEL, DMA_CLASS_3D, 0, MAXRAM, &render_data->render_target_dma_ctx);
-    pb_bind_channel(&render_data->render_target_dma_ctx);
+    // Channel 4 is the fence below. The extra render target channels are above the ones pbkit uses.
+    static const int render_target_dma_channels[SDL_XGU_RENDER_TARGET_DMA_CONTEXTS] = { 3, 13, 14, 15 };
+    for (int i = 0; i < SDL_XGU_RENDER_TARGET_DMA_CONTEXTS; i++) {
+        pb_create_dma_ctx(render_target_dma_channels[i], DMA_CLASS_3D, 0, MAXRAM, &render_data->render_target_dmas[i].ctx);
+        pb_bind_channel(&render_data->render_target_dmas[i].ctx);
+    }
+    render_data->active_render_target_dma = -1;
+
+    // The frame fence is written by the GPU with a semaphore release through its own DMA context
+    const int SDL_XGU_FENCE_DMA_CHANNEL = 4;
+    render_data->fence = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, sizeof(uint32_t));
+    if (render_data->fence == NULL) {
+        pb_kill();
+        SDL_free(render_data->inline_vertices);
+        SDL_free(render_data);
+        return SDL_OutOfMemory();
+    }
+    *render_data->fence = 0;
+    pb_create_dma_ctx(SDL_XGU_FENCE_DMA_CHANNEL, DMA_CLASS_3D, 0, MAXRAM, &render_data->fence_dma_ctx);
+    pb_set_dma_address(&render_data->fence_dma_ctx, (void *)render_data->fence, sizeof(uint32_t) - 1);
+    pb_bind_channel(&render_data->fence_dma_ctx);
+
+    p = push_begin();
+    p = pb_push1(p, NV097_SET_CONTEXT_DMA_SEMAPHORE, render_data->fence_dma_ctx.ChannelID);
+    push_end(p);
 
     renderer->WindowEvent = XBOX_WindowEvent;
     renderer->CreateTexture = XBOX_CreateTexture;
     renderer->UpdateTexture = XBOX_UpdateTexture;
+#ifdef SDL_HAVE_YUV
+    renderer->UpdateTextureYUV = XBOX_UpdateTextureYUV;
+    renderer->UpdateTextureNV = XBOX_UpdateTextureNV;
+#endif
     renderer->LockTexture = XBOX_LockTexture;
     renderer->UnlockTexture = XBOX_UnlockTexture;
     renderer->SetRenderTarget = XBOX_SetRenderTarget;
@@ -934,8 +2160,13 @@ static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_
     render_data->viewport = (SDL_Rect){ 0, 0, pb_back_buffer_width(), pb_back_buffer_height() };
     render_data->clip_rect = render_data->viewport;
 
-    // Point the frame index to what would be the older frame which is the one just after the one we are rendering.
-    render_data->frame_index = 1;
+    // Frame serials start at 1 so a last used frame of 0 means never used
+    render_data->frame_serial = 1;
+
+    // Start vblank tracking from a measured vblank
+    pb_wait_for_vbl();
+    render_data->last_vblank_ns = SDL_GetTicksNS();
+    render_data->vbl_counter = pb_get_vbl_counter();
 
     // These are supported texture formats, however not all of them are supported as render targets.
     // There appears to be no way to differentiate this. CreateTexture will fail if the format is not supported as a render target.
@@ -946,8 +2177,18 @@ static bool XBOX_CreateRenderer(SDL_Renderer *renderer, SDL_Window *window, SDL_
     SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_ABGR8888);
     SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_BGRA8888);
     SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_ARGB4444);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_INDEX8);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_YUY2);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_UYVY);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_IYUV);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_YV12);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_NV12);
+    SDL_AddSupportedTextureFormat(renderer, SDL_PIXELFORMAT_NV21);
     SDL_SetNumberProperty(SDL_GetRendererProperties(renderer), SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 1024 * 1024);
 
+    // SDL only records the vsync mode when XBOX_SetVSync accepts it, but the renderer is always in vsync 1
+    SDL_SetNumberProperty(SDL_GetRendererProperties(renderer), SDL_PROP_RENDERER_VSYNC_NUMBER, 1);
+
     // This hint makes SDL use the driver line API.
     SDL_SetHint(SDL_HINT_RENDER_LINE_METHOD, "2");
 
@@ -971,8 +2212,550 @@ static inline uint32_t npot2pot(uint32_t num)
     if ((1 << msb) == num) {
         return num;
     }
-
-    return 1 << (msb + 1);
+
+    return 1 << (msb + 1);
+}
+
+static bool texture_rect_is_whole(const xgu_texture_t *xgu_texture, const SDL_Rect *rect)
+{
+    return rect->x == 0 && rect->y == 0 &&
+           rect->w == xgu_texture->tex_width && rect->h == xgu_texture->tex_height;
+}
+
+// True if frame has been used but the GPU has not finished rendering it yet. Frame 0 is never used.
+static inline bool frame_in_flight(const xgu_render_data_t *render_data, uint32_t frame)
+{
+    return frame != 0 && (int32_t)(frame - *render_data->fence) > 0;
+}
+
+static void wait_for_frame(xgu_render_data_t *render_data, uint32_t frame)
+{
+    while (frame_in_flight(render_data, frame)) {
+        Sleep(0);
+    }
+}
+
+// Waits until the GPU has finished with memory last read by frame. The frame being built has no fence yet, but
+// everything it has drawn so far has been pushed, so that case waits for the GPU to go idle instead.
+static void wait_for_last_use(xgu_render_data_t *render_data, uint32_t frame)
+{
+    if (frame == render_data->frame_serial) {
+        while (pb_busy()) {
+            Sleep(0);
+        }
+    } else {
+        wait_for_frame(render_data, frame);
+    }
+}
+
+// Makes sure the texture data can be written without changing what the GPU is yet to read. Streaming textures
+// move to a backing buffer that no frame in flight uses, if preserve is true the current contents are copied over.
+// Other textures wait for the last frame that read them, or for atlas textures the last frame that read their page.
+static void texture_acquire_writable(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture, bool preserve)
+{
+    readbacks_settle(render_data, xgu_texture);
+
+    if (xgu_texture->atlas_page) {
+        wait_for_last_use(render_data, xgu_texture->atlas_page->last_used_frame);
+        return;
+    }
+
+    const xgu_texture_buffer_t *current = &xgu_texture->buffers[xgu_texture->buffer_index];
+    if (!frame_in_flight(render_data, current->last_used_frame)) {
+        return;
+    }
+    if (!xgu_texture->streaming) {
+        wait_for_last_use(render_data, current->last_used_frame);
+        return;
+    }
+
+    const size_t size = xgu_texture->buffer_size;
+    for (int i = 1; i < SDL_XGU_STREAMING_BUFFER_COUNT; i++) {
+        const int index = (xgu_texture->buffer_index + i) % SDL_XGU_STREAMING_BUFFER_COUNT;
+        xgu_texture_buffer_t *buffer = &xgu_texture->buffers[index];
+        if (frame_in_flight(render_data, buffer->last_used_frame)) {
+            continue;
+        }
+
+        if (buffer->data == NULL) {
+            buffer->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, size);
+            if (buffer->data == NULL) {
+                break;
+            }
+            buffer->physical_address = (uint8_t *)MmGetPhysicalAddress(buffer->data);
+        }
+
+        if (preserve) {
+            SDL_memcpy(buffer->data, current->data, size);
+        }
+
+        xgu_texture->buffer_index = index;
+        xgu_texture->data = buffer->data;
+        xgu_texture->data_physical_address = buffer->physical_address;
+        return;
+    }
+
+    // Every buffer is still in use, so fall back to waiting for the GPU to finish with the current one
+    wait_for_last_use(render_data, current->last_used_frame);
+}
+
+// Allocates the first GPU copy of an INDEX8 texture's palette. Every entry starts opaque white like a new
+// SDL_Palette, until the texture's SDL palette is first drawn with.
+static bool palette_create(xgu_texture_t *xgu_texture)
+{
+    if (!grow_array((void **)&xgu_texture->palettes, &xgu_texture->palette_capacity, 1, sizeof(xgu_texture_buffer_t))) {
+        return false;
+    }
+    xgu_texture_buffer_t *buffer = &xgu_texture->palettes[0];
+    SDL_zerop(buffer);
+    buffer->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, SDL_XGU_PALETTE_ENTRIES * sizeof(uint32_t));
+    if (buffer->data == NULL) {
+        SDL_free(xgu_texture->palettes);
+        xgu_texture->palettes = NULL;
+        return false;
+    }
+    buffer->physical_address = (uint8_t *)MmGetPhysicalAddress(buffer->data);
+    xgu_texture->palette_count = 1;
+
+    uint32_t *entries = (uint32_t *)buffer->data;
+    for (int i = 0; i < SDL_XGU_PALETTE_ENTRIES; i++) {
+        entries[i] = 0xFFFFFFFF;
+    }
+    return true;
+}
+
+// Returns a GPU copy of the palette that no queued draw or frame in flight reads, starting it from the current
+// palette. Draws read the palette they were queued with, so a palette that changes between draws of the same frame
+// needs a copy for each change. Another copy is allocated when all of them are in use, instead of waiting for
+// the GPU, which could not free copies read by draws that have not been pushed yet. The lowest free copy is
+// reused so the ones at the end go idle and palette_shrink can free them. Returns NULL when out of memory.
+static xgu_texture_buffer_t *palette_acquire_writable(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture)
+{
+    const size_t size = SDL_XGU_PALETTE_ENTRIES * sizeof(uint32_t);
+    if (!frame_in_flight(render_data, xgu_texture->palettes[xgu_texture->palette_index].last_used_frame)) {
+        return &xgu_texture->palettes[xgu_texture->palette_index];
+    }
+
+    size_t index = xgu_texture->palette_count;
+    for (size_t i = 0; i < xgu_texture->palette_count; i++) {
+        if (!frame_in_flight(render_data, xgu_texture->palettes[i].last_used_frame)) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index == xgu_texture->palette_count) {
+        if (!grow_array((void **)&xgu_texture->palettes, &xgu_texture->palette_capacity, index + 1, sizeof(xgu_texture_buffer_t))) {
+            return NULL;
+        }
+        xgu_texture_buffer_t *buffer = &xgu_texture->palettes[index];
+        SDL_zerop(buffer);
+        buffer->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, size);
+        if (buffer->data == NULL) {
+            return NULL;
+        }
+        buffer->physical_address = (uint8_t *)MmGetPhysicalAddress(buffer->data);
+        xgu_texture->palette_count++;
+    }
+
+    xgu_texture_buffer_t *buffer = &xgu_texture->palettes[index];
+    SDL_memcpy(buffer->data, xgu_texture->palettes[xgu_texture->palette_index].data, size);
+    xgu_texture->palette_index = (int)index;
+    return buffer;
+}
+
+// True if a bundle of the renderer draws the texture with the given copy of its palette
+static bool bundles_use_palette(const xgu_render_data_t *render_data, const xgu_texture_t *xgu_texture, int palette_index)
+{
+    for (const SDL_XGU_Bundle *bundle = render_data->bundles; bundle != NULL; bundle = bundle->next) {
+        for (size_t i = 0; i < bundle->texture_count; i++) {
+            if (bundle->textures[i].texture == xgu_texture && bundle->textures[i].palette_index == palette_index) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Frees the last copies of the palette once no draw has read them for SDL_XGU_PALETTE_SHRINK_FRAMES frames, so a
+// burst of palette changes doesn't keep its copies for the lifetime of the texture. Queued draws and bundles refer
+// to copies by index, so only copies at the end of the array are freed.
+static void palette_shrink(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture)
+{
+    while (xgu_texture->palette_count > 1) {
+        const size_t last = xgu_texture->palette_count - 1;
+        xgu_texture_buffer_t *buffer = &xgu_texture->palettes[last];
+        if ((size_t)xgu_texture->palette_index == last || frame_in_flight(render_data, buffer->last_used_frame) ||
+            render_data->frame_serial - buffer->last_used_frame <= SDL_XGU_PALETTE_SHRINK_FRAMES ||
+            bundles_use_palette(render_data, xgu_texture, (int)last)) {
+            return;
+        }
+        contiguous_heap_free(buffer->data);
+        xgu_texture->palette_count--;
+    }
+}
+
+// Copies the texture's SDL palette to the GPU when it has changed since the texture was last queued, so palette
+// animation costs a 1 KB copy instead of an update of the texture. The current copy is then marked as used by the
+// frame being built, so a later change in the same frame goes to another copy. Returns false when out of memory.
+static bool palette_sync(xgu_render_data_t *render_data, SDL_Texture *texture, xgu_texture_t *xgu_texture)
+{
+    palette_shrink(render_data, xgu_texture);
+
+    const SDL_Palette *palette = SDL_GetTexturePalette(texture);
+    if (palette && (palette != xgu_texture->palette_source || palette->version != xgu_texture->palette_version)) {
+        xgu_texture_buffer_t *buffer = palette_acquire_writable(render_data, xgu_texture);
+        if (buffer == NULL) {
+            return false;
+        }
+
+        // Entries past the end of a short SDL palette keep their previous colour
+        uint32_t *entries = (uint32_t *)buffer->data;
+        const int count = SDL_min(palette->ncolors, SDL_XGU_PALETTE_ENTRIES);
+        for (int i = 0; i < count; i++) {
+            const SDL_Color *color = &palette->colors[i];
+            entries[i] = ((uint32_t)color->a << 24) | ((uint32_t)color->r << 16) | ((uint32_t)color->g << 8) | color->b;
+        }
+
+        xgu_texture->palette_source = palette;
+        xgu_texture->palette_version = palette->version;
+        render_data->stats.palette_uploads++;
+    }
+
+    xgu_texture->palettes[xgu_texture->palette_index].last_used_frame = render_data->frame_serial;
+    return true;
+}
+
+// Finds room for a width x height rect on the page, using the first shelf of the right height that has space
+static bool atlas_place(xgu_atlas_page_t *page, int width, int height, int *x, int *y)
+{
+    const int shelf_height = (height + SDL_XGU_ATLAS_SHELF_ALIGN - 1) & ~(SDL_XGU_ATLAS_SHELF_ALIGN - 1);
+    xgu_atlas_shelf_t *shelf = NULL;
+
+    for (int i = 0; i < page->shelf_count; i++) {
+        if (page->shelves[i].height == shelf_height && page->shelves[i].used_width + width <= SDL_XGU_ATLAS_PAGE_SIZE) {
+            shelf = &page->shelves[i];
+            break;
+        }
+    }
+
+    if (shelf == NULL) {
+        if (page->used_height + shelf_height > SDL_XGU_ATLAS_PAGE_SIZE || page->shelf_count == SDL_arraysize(page->shelves)) {
+            return false;
+        }
+        shelf = &page->shelves[page->shelf_count++];
+        shelf->y = page->used_height;
+        shelf->height = shelf_height;
+        shelf->used_width = 0;
+        page->used_height += shelf_height;
+    }
+
+    *x = shelf->used_width;
+    *y = shelf->y;
+    shelf->used_width += width;
+    return true;
+}
+
+// Places the texture on an atlas page of its format, adding a page if none has room. The texture then samples
+// the page, with its texture coordinates scaled and offset to its part of the page.
+static bool atlas_allocate(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture, int width, int height)
+{
+    const int slot_width = width + 2 * SDL_XGU_ATLAS_GUTTER;
+    const int slot_height = height + 2 * SDL_XGU_ATLAS_GUTTER;
+    xgu_atlas_page_t *page;
+    int x, y;
+
+    for (page = render_data->atlas_pages; page != NULL; page = page->next) {
+        if (page->format == xgu_texture->format && atlas_place(page, slot_width, slot_height, &x, &y)) {
+            break;
+        }
+    }
+
+    if (page == NULL) {
+        page = SDL_calloc(1, sizeof(xgu_atlas_page_t));
+        if (page == NULL) {
+            return false;
+        }
+        const size_t size = SDL_XGU_ATLAS_PAGE_SIZE * SDL_XGU_ATLAS_PAGE_SIZE * xgu_texture->bytes_per_pixel;
+        page->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, size);
+        if (page->data == NULL) {
+            SDL_free(page);
+            return false;
+        }
+        SDL_memset(page->data, 0, size);
+        page->physical_address = (uint8_t *)MmGetPhysicalAddress(page->data);
+        page->format = xgu_texture->format;
+        page->bytes_per_pixel = xgu_texture->bytes_per_pixel;
+        atlas_place(page, slot_width, slot_height, &x, &y);
+
+        page->next = render_data->atlas_pages;
+        render_data->atlas_pages = page;
+    }
+    page->texture_count++;
+
+    xgu_texture->atlas_page = page;
+    xgu_texture->atlas_x = x + SDL_XGU_ATLAS_GUTTER;
+    xgu_texture->atlas_y = y + SDL_XGU_ATLAS_GUTTER;
+    xgu_texture->data_width = SDL_XGU_ATLAS_PAGE_SIZE;
+    xgu_texture->data_height = SDL_XGU_ATLAS_PAGE_SIZE;
+    xgu_texture->pitch = SDL_XGU_ATLAS_PAGE_SIZE * xgu_texture->bytes_per_pixel;
+    xgu_texture->data = page->data;
+    xgu_texture->data_physical_address = page->physical_address;
+    xgu_texture->u_scale = (float)width / SDL_XGU_ATLAS_PAGE_SIZE;
+    xgu_texture->v_scale = (float)height / SDL_XGU_ATLAS_PAGE_SIZE;
+    xgu_texture->u_offset = (float)xgu_texture->atlas_x / SDL_XGU_ATLAS_PAGE_SIZE;
+    xgu_texture->v_offset = (float)xgu_texture->atlas_y / SDL_XGU_ATLAS_PAGE_SIZE;
+    return true;
+}
+
+// Frees the texture's page once no texture uses it. The caller has already waited for the GPU to finish with it.
+static void atlas_release(xgu_render_data_t *render_data, xgu_texture_t *xgu_texture)
+{
+    xgu_atlas_page_t *page = xgu_texture->atlas_page;
+    if (page == NULL || --page->texture_count > 0) {
+        return;
+    }
+
+    for (xgu_atlas_page_t **link = &render_data->atlas_pages; *link != NULL; link = &(*link)->next) {
+        if (*link == page) {
+            *link = page->next;
+            break;
+        }
+    }
+    contiguous_heap_free(page->data);
+    SDL_free(page);
+}
+
+// Swizzles rect of the texture into its place on the atlas page. Pixels on the edge of the texture are also
+// copied into the gutter around it.
+static void atlas_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const uint8_t *src, int pitch)
+{
+    const int bpp = xgu_texture->bytes_per_pixel;
+    const int x = xgu_texture->atlas_x + rect->x;
+    const int y = xgu_texture->atlas_y + rect->y;
+    const int right = rect->x + rect->w == xgu_texture->tex_width;
+    const int bottom = rect->y + rect->h == xgu_texture->tex_height;
+    const uint8_t *last_row = src + (rect->h - 1) * pitch;
+    const int last_column = (rect->w - 1) * bpp;
+
+    swizzle_subrect(src, x, y, rect->w, rect->h, xgu_texture->data,
+                    SDL_XGU_ATLAS_PAGE_SIZE, SDL_XGU_ATLAS_PAGE_SIZE, pitch, bpp);
+
+#define ATLAS_GUTTER(source, gx, gy, gw, gh) \
+    swizzle_subrect((source), (gx), (gy), (gw), (gh), xgu_texture->data, SDL_XGU_ATLAS_PAGE_SIZE, SDL_XGU_ATLAS_PAGE_SIZE, pitch, bpp)
+
+    for (int g = 1; g <= SDL_XGU_ATLAS_GUTTER; g++) {
+        if (rect->x == 0) {
+            ATLAS_GUTTER(src, x - g, y, 1, rect->h);
+        }
+        if (right) {
+            ATLAS_GUTTER(src + last_column, x + rect->w - 1 + g, y, 1, rect->h);
+        }
+        if (rect->y == 0) {
+            ATLAS_GUTTER(src, x, y - g, rect->w, 1);
+        }
+        if (bottom) {
+            ATLAS_GUTTER(last_row, x, y + rect->h - 1 + g, rect->w, 1);
+        }
+        for (int h = 1; h <= SDL_XGU_ATLAS_GUTTER; h++) {
+            if (rect->x == 0 && rect->y == 0) {
+                ATLAS_GUTTER(src, x - g, y - h, 1, 1);
+            }
+            if (right && rect->y == 0) {
+                ATLAS_GUTTER(src + last_column, x + rect->w - 1 + g, y - h, 1, 1);
+            }
+            if (rect->x == 0 && bottom) {
+                ATLAS_GUTTER(last_row, x - g, y + rect->h - 1 + h, 1, 1);
+            }
+            if (right && bottom) {
+                ATLAS_GUTTER(last_row + last_column, x + rect->w - 1 + g, y + rect->h - 1 + h, 1, 1);
+            }
+        }
+    }
+
+#undef ATLAS_GUTTER
+}
+
+// Copies DXT blocks of rect into the texture. src holds rows of 4x4 blocks, pitch bytes apart.
+static bool compressed_texture_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const uint8_t *src, int pitch)
+{
+    if ((rect->x % 4) || (rect->y % 4) ||
+        ((rect->w % 4) && rect->x + rect->w != xgu_texture->tex_width) ||
+        ((rect->h % 4) && rect->y + rect->h != xgu_texture->tex_height)) {
+        return SDL_SetError("[nxdk renderer] Compressed texture updates must be aligned to 4x4 blocks");
+    }
+
+    const int block_columns = (rect->w + 3) / 4;
+    const int block_rows = (rect->h + 3) / 4;
+    uint8_t *dst = xgu_texture->data + (rect->y / 4) * xgu_texture->pitch + (rect->x / 4) * xgu_texture->block_size;
+    for (int row = 0; row < block_rows; row++) {
+        SDL_memcpy(dst, src, block_columns * xgu_texture->block_size);
+        dst += xgu_texture->pitch;
+        src += pitch;
+    }
+    return true;
+}
+
+// Creates a texture that stores DXT blocks. The NV2A reads compressed textures in plain block order, not swizzled,
+// but they still need power of two dimensions and normalised texture coordinates.
+static bool compressed_texture_create(xgu_render_data_t *render_data, SDL_Texture *texture, xgu_texture_t *xgu_texture,
+                                      SDL_PropertiesID create_props)
+{
+    const Sint64 compressed_format = SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_FORMAT_NUMBER, SDL_XGU_COMPRESSED_NONE);
+    switch (compressed_format) {
+    case SDL_XGU_COMPRESSED_DXT1:
+        xgu_texture->format = XGU_TEXTURE_FORMAT_DXT1_A1R5G5B5;
+        xgu_texture->block_size = 8;
+        break;
+    case SDL_XGU_COMPRESSED_DXT3:
+        xgu_texture->format = XGU_TEXTURE_FORMAT_DXT23_A8R8G8B8;
+        xgu_texture->block_size = 16;
+        break;
+    case SDL_XGU_COMPRESSED_DXT5:
+        xgu_texture->format = XGU_TEXTURE_FORMAT_DXT45_A8R8G8B8;
+        xgu_texture->block_size = 16;
+        break;
+    default:
+        return SDL_SetError("[nxdk renderer] Unsupported compressed texture format (%d)", (int)compressed_format);
+    }
+    if (SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_ACCESS_NUMBER, 0) != SDL_TEXTUREACCESS_STATIC) {
+        return SDL_SetError("[nxdk renderer] Compressed textures must be static");
+    }
+
+    xgu_texture->tex_width = texture->w;
+    xgu_texture->tex_height = texture->h;
+    xgu_texture->data_width = npot2pot(SDL_max(texture->w, 4));
+    xgu_texture->data_height = npot2pot(SDL_max(texture->h, 4));
+    xgu_texture->u_scale = (float)xgu_texture->tex_width / (float)xgu_texture->data_width;
+    xgu_texture->v_scale = (float)xgu_texture->tex_height / (float)xgu_texture->data_height;
+    // Bytes per row of blocks
+    xgu_texture->pitch = (xgu_texture->data_width / 4) * xgu_texture->block_size;
+
+    const size_t allocation_size = (size_t)xgu_texture->pitch * (xgu_texture->data_height / 4);
+    xgu_texture->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, allocation_size);
+    if (xgu_texture->data == NULL) {
+        return SDL_OutOfMemory();
+    }
+    xgu_texture->data_physical_address = (uint8_t *)MmGetPhysicalAddress(xgu_texture->data);
+    SDL_memset(xgu_texture->data, 0, allocation_size);
+
+    xgu_texture->buffers[0].data = xgu_texture->data;
+    xgu_texture->buffers[0].physical_address = xgu_texture->data_physical_address;
+
+    const void *blocks = SDL_GetPointerProperty(create_props, SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_DATA_POINTER, NULL);
+    if (blocks) {
+        const SDL_Rect rect = { 0, 0, texture->w, texture->h };
+        compressed_texture_update(xgu_texture, &rect, blocks, ((texture->w + 3) / 4) * xgu_texture->block_size);
+    }
+
+    xgu_texture->compressed_saving = (size_t)xgu_texture->data_width * xgu_texture->data_height * 4 - allocation_size;
+    render_data->compressed_saving += xgu_texture->compressed_saving;
+    return true;
+}
+
+// Packs a combiner factor in [-1, 1] so that the expand normal input mapping reads it back
+static uint32_t yuv_combiner_factor(float r, float g, float b)
+{
+    const uint32_t r8 = (uint32_t)SDL_lroundf((r + 1.0f) * 127.5f);
+    const uint32_t g8 = (uint32_t)SDL_lroundf((g + 1.0f) * 127.5f);
+    const uint32_t b8 = (uint32_t)SDL_lroundf((b + 1.0f) * 127.5f);
+    return 0xFF000000 | (r8 << 16) | (g8 << 8) | b8;
+}
+
+// Lays out a YUV texture in one buffer and returns its size. The planes of planar formats follow each other in the
+// order SDL_LockTexture returns them, with a Y pitch that keeps every plane's pitch a multiple of 64 bytes.
+// The combiner constants that convert the texture's colorspace to RGB are set up here too.
+static size_t yuv_texture_layout(xgu_texture_t *xgu_texture, SDL_PixelFormat format, SDL_PropertiesID create_props)
+{
+    // Packed 4:2:2 formats hold two pixels in each four bytes and are converted by the texture unit
+    if (format == SDL_PIXELFORMAT_YUY2 || format == SDL_PIXELFORMAT_UYVY) {
+        xgu_texture->data_width = (xgu_texture->tex_width + 1) & ~1;
+        xgu_texture->pitch = xgu_texture->data_width * xgu_texture->bytes_per_pixel;
+        return (size_t)xgu_texture->pitch * xgu_texture->data_height;
+    }
+
+    const int chroma_height = (xgu_texture->tex_height + 1) / 2;
+    xgu_texture->pitch = (xgu_texture->tex_width + SDL_XGU_YUV_PITCH_ALIGN - 1) & ~(SDL_XGU_YUV_PITCH_ALIGN - 1);
+    xgu_texture->chroma_offsets[0] = (size_t)xgu_texture->pitch * xgu_texture->data_height;
+    size_t size;
+    if (format == SDL_PIXELFORMAT_NV12 || format == SDL_PIXELFORMAT_NV21) {
+        xgu_texture->planes = 2;
+        xgu_texture->chroma_pitch = xgu_texture->pitch;
+        size = xgu_texture->chroma_offsets[0] + (size_t)xgu_texture->chroma_pitch * chroma_height;
+    } else {
+        xgu_texture->planes = 3;
+        xgu_texture->chroma_pitch = xgu_texture->pitch / 2;
+        const size_t second_offset = xgu_texture->chroma_offsets[0] + (size_t)xgu_texture->chroma_pitch * chroma_height;
+        size = second_offset + (size_t)xgu_texture->chroma_pitch * chroma_height;
+        // YV12 stores V before U
+        if (format == SDL_PIXELFORMAT_YV12) {
+            xgu_texture->chroma_offsets[1] = xgu_texture->chroma_offsets[0];
+            xgu_texture->chroma_offsets[0] = second_offset;
+        } else {
+            xgu_texture->chroma_offsets[1] = second_offset;
+        }
+    }
+
+    // Y scale, Y offset, U to green, U to blue, V to red, V to green
+    static const float bt601_limited[6] = { 1.1644f, -0.0730f, -0.3918f, 2.0172f, 1.5960f, -0.8130f };
+    static const float bt709_limited[6] = { 1.1644f, -0.0730f, -0.2132f, 2.1124f, 1.7927f, -0.5329f };
+    static const float bt601_full[6] = { 1.0f, 0.0f, -0.3441f, 1.7720f, 1.4020f, -0.7141f };
+    static const float bt709_full[6] = { 1.0f, 0.0f, -0.1873f, 1.8556f, 1.5748f, -0.4681f };
+    const SDL_Colorspace colorspace = (SDL_Colorspace)SDL_GetNumberProperty(create_props, SDL_PROP_TEXTURE_CREATE_COLORSPACE_NUMBER,
+                                                                            SDL_COLORSPACE_BT601_LIMITED);
+    const float *m;
+    if (SDL_ISCOLORSPACE_MATRIX_BT709(colorspace)) {
+        m = SDL_ISCOLORSPACE_FULL_RANGE(colorspace) ? bt709_full : bt709_limited;
+    } else {
+        m = SDL_ISCOLORSPACE_FULL_RANGE(colorspace) ? bt601_full : bt601_limited;
+    }
+
+    // Stage 0 picks U and V out of the interleaved plane of NV12 and NV21. Later stages hold the coefficients
+    // divided by 4, because combiner values are limited to [-1, 1], and stage 3 multiplies the sum by 4 again.
+    uint32_t(*factors)[2] = xgu_texture->combiner_factors;
+    if (format == SDL_PIXELFORMAT_NV12) {
+        factors[0][0] = 0x000000FF;
+        factors[0][1] = 0x0000FF00;
+    } else if (format == SDL_PIXELFORMAT_NV21) {
+        factors[0][0] = 0x0000FF00;
+        factors[0][1] = 0x000000FF;
+    }
+    factors[1][0] = yuv_combiner_factor(0.0f, m[2] / 4.0f, m[3] / 4.0f);
+    factors[1][1] = yuv_combiner_factor(m[4] / 4.0f, m[5] / 4.0f, 0.0f);
+    factors[2][0] = yuv_combiner_factor(m[0] / 4.0f, m[0] / 4.0f, m[0] / 4.0f);
+    factors[2][1] = yuv_combiner_factor(m[1] / 4.0f, m[1] / 4.0f, m[1] / 4.0f);
+    return size;
+}
+
+// Copies rect of each plane into a planar YUV texture. v_plane is NULL for NV12 and NV21, where u_plane holds
+// the interleaved chroma.
+static void yuv_texture_update(xgu_texture_t *xgu_texture, const SDL_Rect *rect, const Uint8 *y_plane, int y_pitch,
+                               const Uint8 *u_plane, int u_pitch, const Uint8 *v_plane, int v_pitch)
+{
+    uint8_t *dst = xgu_texture->data + rect->y * xgu_texture->pitch + rect->x;
+    for (int row = 0; row < rect->h; row++) {
+        SDL_memcpy(dst, y_plane, rect->w);
+        dst += xgu_texture->pitch;
+        y_plane += y_pitch;
+    }
+
+    const int chroma_x = rect->x / 2;
+    const int chroma_y = rect->y / 2;
+    const int chroma_width = (rect->w + 1) / 2;
+    const int chroma_height = (rect->h + 1) / 2;
+    const int bytes_per_sample = (v_plane) ? 1 : 2;
+    const Uint8 *planes[2] = { u_plane, v_plane };
+    const int pitches[2] = { u_pitch, v_pitch };
+    for (int plane = 0; plane < xgu_texture->planes - 1; plane++) {
+        const Uint8 *src = planes[plane];
+        dst = xgu_texture->data + xgu_texture->chroma_offsets[plane] + chroma_y * xgu_texture->chroma_pitch +
+              chroma_x * bytes_per_sample;
+        for (int row = 0; row < chroma_height; row++) {
+            SDL_memcpy(dst, src, chroma_width * bytes_per_sample);
+            dst += xgu_texture->chroma_pitch;
+            src += pitches[plane];
+        }
+    }
 }
 
 static bool sdl_to_xgu_surface_format(SDL_PixelFormat sdl_format, int *xgu_surface_format, int *bytes_per_pixel)
@@ -1027,6 +2810,28 @@ static bool sdl_to_xgu_texture_format(SDL_PixelFormat fmt, int *xgu_format, int
         *xgu_format = (swizzled) ? XGU_TEXTURE_FORMAT_X1R5G5B5_SWIZZLED : XGU_TEXTURE_FORMAT_X1R5G5B5;
         *bytes_per_pixel = 2;
         return true;
+    case SDL_PIXELFORMAT_INDEX8:
+        // There is no linear palette format
+        *xgu_format = XGU_TEXTURE_FORMAT_I8_A8R8G8B8_SWIZZLED;
+        *bytes_per_pixel = 1;
+        return swizzled;
+    // There are no swizzled YUV formats. Planar formats store the Y plane here, the chroma planes are
+    // sampled on texture units 1 and 2.
+    case SDL_PIXELFORMAT_YUY2:
+        *xgu_format = XGU_TEXTURE_FORMAT_CR8YB8CB8YA8;
+        *bytes_per_pixel = 2;
+        return !swizzled;
+    case SDL_PIXELFORMAT_UYVY:
+        *xgu_format = XGU_TEXTURE_FORMAT_YB8CR8YA8CB8;
+        *bytes_per_pixel = 2;
+        return !swizzled;
+    case SDL_PIXELFORMAT_IYUV:
+    case SDL_PIXELFORMAT_YV12:
+    case SDL_PIXELFORMAT_NV12:
+    case SDL_PIXELFORMAT_NV21:
+        *xgu_format = XGU_TEXTURE_FORMAT_Y8;
+        *bytes_per_pixel = 1;
+        return !swizzled;
     default:
         return false;
     }
@@ -1035,60 +2840,200 @@ static bool sdl_to_xgu_texture_format(SDL_PixelFormat fmt, int *xgu_format, int
 static bool arena_init(SDL_Renderer *renderer)
 {
     xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
-    render_data->vertex_data = MmAllocateContiguousMemoryEx(SDL_XGU_VERTEX_BUFFER_SIZE, 0, 0xFFFFFFFF, 0,
-                                                            PAGE_WRITECOMBINE | PAGE_READWRITE);
-    if (render_data->vertex_data == NULL) {
+    if (arena_add_chunk(render_data, SDL_XGU_VERTEX_CHUNK_SIZE) == NULL) {
         SDL_SetError("Failed to allocate XGU arena");
         return false;
     }
+    return true;
+}
+
+static xgu_arena_chunk_t *arena_add_chunk(xgu_render_data_t *render_data, size_t size)
+{
+    xgu_arena_chunk_t *chunk = (xgu_arena_chunk_t *)SDL_calloc(1, sizeof(xgu_arena_chunk_t));
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->size = SDL_max(size, SDL_XGU_VERTEX_CHUNK_SIZE);
+    chunk->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, chunk->size);
+    if (chunk->data == NULL) {
+        SDL_free(chunk);
+        return NULL;
+    }
 
-    renderer->vertex_data = render_data->vertex_data;
-    render_data->vertex_arena_offset = 0;
+    chunk->next = render_data->arena_chunks;
+    render_data->arena_chunks = chunk;
+    render_data->arena_current = chunk;
+    render_data->arena_offset = 0;
 
-    return true;
+    render_data->arena_size += chunk->size;
+    render_data->arena_high_water = SDL_max(render_data->arena_high_water, render_data->arena_size);
+    return chunk;
 }
 
-static void *arena_allocate(SDL_Renderer *renderer, size_t size, size_t *vertex_data_offset)
+// Switches to a chunk that the GPU has finished with and that can hold size bytes. If every chunk is
+// still in use by a frame in flight the arena grows by another chunk.
+static xgu_arena_chunk_t *arena_next_chunk(xgu_render_data_t *render_data, size_t size)
 {
-    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
-    int total_allocated = 0;
+    for (xgu_arena_chunk_t *chunk = render_data->arena_chunks; chunk != NULL; chunk = chunk->next) {
+        if (chunk != render_data->arena_current && chunk->size >= size &&
+            !frame_in_flight(render_data, chunk->last_used_frame)) {
+            render_data->arena_current = chunk;
+            render_data->arena_offset = 0;
+            return chunk;
+        }
+    }
+    return arena_add_chunk(render_data, size);
+}
 
-    // Ensure alignment. If every allocation is aligned, we know every pointer will be aligned.
-    size = (size + SDL_XGU_VERTEX_ALIGNMENT - 1) & ~(SDL_XGU_VERTEX_ALIGNMENT - 1);
+// Frees chunks that no frame has used for SDL_XGU_VERTEX_SHRINK_FRAMES frames, so a spike in geometry
+// doesn't hold on to memory forever.
+static void arena_shrink(xgu_render_data_t *render_data)
+{
+    xgu_arena_chunk_t **link = &render_data->arena_chunks;
+    while (*link != NULL) {
+        xgu_arena_chunk_t *chunk = *link;
+        if (chunk == render_data->arena_current || frame_in_flight(render_data, chunk->last_used_frame) ||
+            render_data->frame_serial - chunk->last_used_frame <= SDL_XGU_VERTEX_SHRINK_FRAMES) {
+            link = &chunk->next;
+            continue;
+        }
 
-    if (render_data->vertex_arena_offset + size > SDL_XGU_VERTEX_BUFFER_SIZE) {
-        // We lost some space to end padding, so ensure we tag that on when we validate our allocation size
-        total_allocated += render_data->vertex_arena_offset + size - SDL_XGU_VERTEX_BUFFER_SIZE;
+        *link = chunk->next;
+        render_data->arena_size -= chunk->size;
+        contiguous_heap_free(chunk->data);
+        SDL_free(chunk);
+    }
+}
 
-        // Round robin back to the start of the arena
-        render_data->vertex_arena_offset = 0;
+static void arena_destroy(xgu_render_data_t *render_data)
+{
+    while (render_data->arena_chunks) {
+        xgu_arena_chunk_t *chunk = render_data->arena_chunks;
+        render_data->arena_chunks = chunk->next;
+        contiguous_heap_free(chunk->data);
+        SDL_free(chunk);
     }
+    render_data->arena_current = NULL;
+    render_data->arena_size = 0;
+}
 
-    // Area we going to overflow the vertex buffer?
-    for (int i = 0; i < SDL_XGU_BUFFER_COUNT; i++) {
-        total_allocated += render_data->vertex_allocations[i];
+// Small allocations go in the inline buffer so they can be pushed with the draw, the rest go in the vertex arena
+static void *vertex_allocate(SDL_Renderer *renderer, size_t size, size_t alignment, size_t *vertex_data_offset, bool allow_inline)
+{
+    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    render_data->stats.vertex_bytes += size;
+
+    if (allow_inline && render_data->inline_vertices && size <= SDL_XGU_INLINE_VERTEX_SIZE) {
+        const size_t start_offset = (render_data->inline_vertices_offset + alignment - 1) & ~(alignment - 1);
+        if (start_offset + size <= SDL_XGU_INLINE_BUFFER_SIZE) {
+            void *ptr = render_data->inline_vertices + start_offset;
+            render_data->inline_vertices_offset = start_offset + size;
+            *vertex_data_offset = (size_t)(uintptr_t)ptr;
+            return ptr;
+        }
     }
-    if (total_allocated + size > SDL_XGU_VERTEX_BUFFER_SIZE) {
-        SDL_Log("Vertex buffer overflow. Increase SDL_XGU_VERTEX_BUFFER_SIZE", size);
-        return NULL;
+    if (render_data->recording) {
+        return bundle_allocate_vertices(render_data->recording, size, alignment, vertex_data_offset);
+    }
+    return arena_allocate(renderer, size, alignment, vertex_data_offset);
+}
+
+// Allocations are bump allocated from the current chunk. The address of the allocation is returned in
+// vertex_data_offset, commands keep it in cmd->data.draw.first.
+static void *arena_allocate(SDL_Renderer *renderer, size_t size, size_t alignment, size_t *vertex_data_offset)
+{
+    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    xgu_arena_chunk_t *chunk = render_data->arena_current;
+
+    // Ensure alignment. Chunks start on an alignment boundary that is larger than any vertex alignment.
+    size_t start_offset = (render_data->arena_offset + alignment - 1) & ~(alignment - 1);
+    if (chunk == NULL || start_offset + size > chunk->size) {
+        chunk = arena_next_chunk(render_data, size);
+        if (chunk == NULL) {
+            SDL_Log("Failed to grow the XGU vertex arena by %u bytes", (unsigned int)size);
+            return NULL;
+        }
+        start_offset = 0;
     }
 
-    void *ptr = (void *)((intptr_t)render_data->vertex_data + render_data->vertex_arena_offset);
-    assert(((intptr_t)ptr & (SDL_XGU_VERTEX_ALIGNMENT - 1)) == 0);
+    void *ptr = chunk->data + start_offset;
+    assert(((intptr_t)ptr & (alignment - 1)) == 0);
 
-    *vertex_data_offset = render_data->vertex_arena_offset;
-    render_data->vertex_arena_offset += size;
-    render_data->vertex_allocations[render_data->frame_index] += size;
+    chunk->last_used_frame = render_data->frame_serial;
+    render_data->arena_offset = start_offset + size;
+    *vertex_data_offset = (size_t)(uintptr_t)ptr;
     return ptr;
 }
 
-static void set_blend_mode(SDL_Renderer *renderer, SDL_BlendMode blendMode)
+static uint32_t *index_stream_reserve(SDL_Renderer *renderer, size_t count)
 {
-    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    const size_t required = render_data->index_stream_length + count;
 
-    if (blendMode == render_data->active_blend_mode) {
-        return;
+    if (required > render_data->index_stream_capacity) {
+        const size_t capacity = SDL_max(render_data->index_stream_capacity * 2, required);
+        uint32_t *index_stream = (uint32_t *)SDL_realloc(render_data->index_stream, capacity * sizeof(uint32_t));
+        if (index_stream == NULL) {
+            return NULL;
+        }
+        render_data->index_stream = index_stream;
+        render_data->index_stream_capacity = capacity;
+    }
+
+    return &render_data->index_stream[render_data->index_stream_length];
+}
+
+// Pushes register state that was built in system memory with the xgu helpers. Methods that would leave every
+// register they write unchanged are dropped. Only register state can be pushed this way, not methods that
+// trigger work like NV097_SET_BEGIN_END or NV097_WAIT_FOR_IDLE.
+static void state_push(xgu_render_data_t *render_data, enum xgu_state_type type, const uint32_t *start, const uint32_t *end)
+{
+    xgu_state_shadow_t *shadow = &render_data->state;
+    bool reserved = false;
+
+    assert(end - start <= SDL_XGU_STATE_BATCH);
+
+    while (start < end) {
+        const uint32_t header = *start++;
+        const uint32_t count = state_shadow_method_count(header);
+        const uint32_t *values = start;
+        start += count;
+
+        if (!state_shadow_update(shadow, header, values)) {
+            continue;
+        }
+
+        // Reserve room for everything that is left so the reservation is only checked once
+        if (!reserved) {
+            push_reserve(1 + count + (end - start));
+            reserved = true;
+        }
+        render_data->stats.state_changes[type]++;
+        *p++ = header;
+        // Recorded viewport offsets are moved by the translation the bundle is drawn with
+        if (push_bundle && ((header & XGU_METHOD_MASK) >> 2) == (NV097_SET_VIEWPORT_OFFSET >> 2)) {
+            bundle_add_viewport_patch(push_bundle, p - push_bundle->commands);
+        }
+        SDL_memcpy(p, values, count * sizeof(uint32_t));
+        p += count;
     }
+}
+
+// Makes the next state_push of this method emit it, whatever its value
+static void state_forget(xgu_render_data_t *render_data, uint32_t method)
+{
+    state_shadow_forget(&render_data->state, method);
+}
+
+static void state_invalidate(xgu_render_data_t *render_data)
+{
+    state_shadow_invalidate(&render_data->state);
+}
+
+static void set_blend_mode(SDL_Renderer *renderer, SDL_BlendMode blendMode)
+{
+    SDL_XGU_MAYBE_UNUSED xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
 
     XguBlendFactor sfactor;
     XguBlendFactor dfactor;
@@ -1128,13 +3073,12 @@ static void set_blend_mode(SDL_Renderer *renderer, SDL_BlendMode blendMode)
         dfactor = XGU_FACTOR_ONE_MINUS_SRC_ALPHA;
     }
 
-    p = pb_begin();
-    p = xgu_set_blend_func_sfactor(p, sfactor);
-    p = xgu_set_blend_func_dfactor(p, dfactor);
-    p = push_command_parameter(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
-    pb_end(p);
-
-    render_data->active_blend_mode = blendMode;
+    uint32_t state[SDL_XGU_STATE_BATCH];
+    uint32_t *s = state;
+    s = xgu_set_blend_func_sfactor(s, sfactor);
+    s = xgu_set_blend_func_dfactor(s, dfactor);
+    s = push_command_parameter(s, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
+    state_push(render_data, XGU_STATE_BLEND, state, s);
 }
 
 static SDL_Rect sanitize_scissor_rect(SDL_Renderer *renderer, const SDL_Rect *rect)
@@ -1238,7 +3182,7 @@ static inline void combiner_init(void)
     p += 2;
 }
 
-static inline void unlit_combiner_apply (void)
+static inline uint32_t *unlit_combiner_apply(uint32_t *p)
 {
     p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
     p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, 0);
@@ -1254,9 +3198,17 @@ static inline void unlit_combiner_apply (void)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_MAP, 0x1)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x0));
+
+    // Undo the YUV combiner, which writes stage 0 elsewhere and runs more stages
+    p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + 0 * 4, XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0x4));
+    p = pb_push1(p, NV097_SET_COMBINER_CONTROL,
+        XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, 1));
+    return p;
 }
 
-static inline void texture_combiner_apply (void)
+static inline uint32_t *texture_combiner_apply(uint32_t *p)
 {
     p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
     p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, XGU_MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, NV097_SET_SHADER_STAGE_PROGRAM_STAGE0_2D_PROJECTIVE));
@@ -1272,9 +3224,203 @@ static inline void texture_combiner_apply (void)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE, 0x4) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_MAP, 0x6)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_C_MAP, 0x0)
         | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_D_MAP, 0x0));
+
+    // Undo the YUV combiner, which writes stage 0 elsewhere and runs more stages
+    p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + 0 * 4, XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0x4));
+    p = pb_push1(p, NV097_SET_COMBINER_CONTROL,
+        XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_SAME_FACTOR_ALL)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_SAME_FACTOR_ALL)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, 1));
+    return p;
+}
+
+// Converts planar YUV to RGB. Texture units 1 and 2 sample the chroma planes, the stages compute
+//   stage 0: R0 = U - 0.5, R1 = V - 0.5
+//   stage 1: R0 = R0 * C0 + R1 * C1                 (U and V contributions to RGB)
+//   stage 2: R1 = Y * C0 + C1                       (scaled and offset Y)
+//   stage 3: R0 = (R0 + R1) * 4
+//   stage 4: V0 = R0 * V0                           (modulate by the vertex colour)
+// with the constants of each stage in xgu_texture->combiner_factors.
+static inline uint32_t *yuv_combiner_apply(uint32_t *p, const xgu_texture_t *xgu_texture)
+{
+    p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT, 0);
+    p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM,
+        XGU_MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, NV097_SET_SHADER_STAGE_PROGRAM_STAGE0_2D_PROJECTIVE)
+        | XGU_MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE1, NV097_SET_SHADER_STAGE_PROGRAM_STAGE1_2D_PROJECTIVE)
+        | XGU_MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE2, (xgu_texture->planes == 3) ? NV097_SET_SHADER_STAGE_PROGRAM_STAGE2_2D_PROJECTIVE
+                                                                                     : NV097_SET_SHADER_STAGE_PROGRAM_STAGE2_PROGRAM_NONE));
+    p = pb_push1(p, NV097_SET_COMBINER_CONTROL,
+        XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_EACH_STAGE)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_EACH_STAGE)
+        | XGU_MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, SDL_XGU_YUV_COMBINER_STAGES));
+    return p;
+}
+
+static inline uint32_t *yuv_combiner_stage_apply(uint32_t *p, const xgu_texture_t *xgu_texture, int stage)
+{
+    uint32_t color_icw = 0;
+    uint32_t color_ocw = 0;
+    uint32_t alpha_icw = 0;
+    uint32_t alpha_ocw = 0;
+
+    switch (stage) {
+    case 0:
+        if (xgu_texture->planes == 2) {
+            // Dot the interleaved chroma with the C0 and C1 selectors
+            color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0x9) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x4)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x1) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x0)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0x9) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x4)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x2) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x0);
+            color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0xC) | XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DST, 0xD)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DOT_ENABLE, 1) | XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DOT_ENABLE, 1);
+        } else {
+            color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0x9) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x4)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x1)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0xA) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x4)
+                | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x1);
+            color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0xC) | XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_CD_DST, 0xD);
+        }
+        // Alpha comes from the vertex colour, as for untextured geometry
+        alpha_icw = XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_A_SOURCE, 0x4) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_A_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_A_MAP, 0x6)
+            | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_ALPHA, 1) | XGU_MASK(NV097_SET_COMBINER_ALPHA_ICW_B_MAP, 0x1);
+        alpha_ocw = XGU_MASK(NV097_SET_COMBINER_ALPHA_OCW_AB_DST, 0x4);
+        break;
+    case 1:
+        color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0xC) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x6)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x1) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x2)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0xD) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x6)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x2) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x2);
+        color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_SUM_DST, 0xC);
+        break;
+    case 2:
+        color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0x8) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x0)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x1) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x2)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0x2) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x2)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x1);
+        color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_SUM_DST, 0xD);
+        break;
+    case 3:
+        color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0xC) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x6)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x1)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_SOURCE, 0xD) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_C_MAP, 0x6)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_SOURCE, 0x0) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_D_MAP, 0x1);
+        color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_SUM_DST, 0xC)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_OP, NV097_SET_COMBINER_COLOR_OCW_OP_SHIFTLEFTBY2);
+        break;
+    default:
+        // Negative results are clamped to 0 by the unsigned mapping of R0
+        color_icw = XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_SOURCE, 0xC) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_A_MAP, 0x0)
+            | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_SOURCE, 0x4) | XGU_MASK(NV097_SET_COMBINER_COLOR_ICW_B_MAP, 0x0);
+        color_ocw = XGU_MASK(NV097_SET_COMBINER_COLOR_OCW_AB_DST, 0x4);
+        break;
+    }
+
+    p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + stage * 4, color_icw);
+    p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + stage * 4, color_ocw);
+    p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + stage * 4, alpha_icw);
+    p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + stage * 4, alpha_ocw);
+    p = pb_push1(p, NV097_SET_COMBINER_FACTOR0 + stage * 4, xgu_texture->combiner_factors[stage][0]);
+    p = pb_push1(p, NV097_SET_COMBINER_FACTOR1 + stage * 4, xgu_texture->combiner_factors[stage][1]);
+    return p;
 }
 // clang-format on
 
+#if SDL_XGU_SHOW_STATS
+static Uint64 stats_history_cpu_ns[SDL_XGU_STATS_HISTORY];
+static Uint64 stats_history_wait_ns[SDL_XGU_STATS_HISTORY];
+static int stats_history_index = 0;
+
+// Graphs the CPU time spent running the command queue (green) and waiting in SDL_RenderPresent (red) for recent
+// frames, scaled so the full height of the graph is one refresh period, with the last frame's counters above it.
+static void stats_draw(const xgu_render_data_t *render_data, const xgu_frame_stats_t *stats, int state_changes)
+{
+    const int bar_width = 4;
+    const int graph_height = 60;
+    const int graph_x = 20;
+    const int graph_bottom = pb_back_buffer_height() - 40;
+    const Uint64 scale_ns = render_data->refresh_period_ns;
+
+    stats_history_cpu_ns[stats_history_index] = stats->command_queue_ns;
+    stats_history_wait_ns[stats_history_index] = render_data->present_wait_ns;
+    stats_history_index = (stats_history_index + 1) % SDL_XGU_STATS_HISTORY;
+
+    pb_fill(graph_x, graph_bottom - graph_height, SDL_XGU_STATS_HISTORY * bar_width, graph_height, 0xFF000000);
+    for (int i = 0; i < SDL_XGU_STATS_HISTORY; i++) {
+        const int index = (stats_history_index + i) % SDL_XGU_STATS_HISTORY;
+        const int x = graph_x + i * bar_width;
+        const int cpu_height = (int)SDL_min(stats_history_cpu_ns[index] * graph_height / scale_ns, (Uint64)graph_height);
+        const int wait_height = (int)SDL_min(stats_history_wait_ns[index] * graph_height / scale_ns, (Uint64)(graph_height - cpu_height));
+        if (cpu_height > 0) {
+            pb_fill(x, graph_bottom - cpu_height, bar_width - 1, cpu_height, 0xFF00C000);
+        }
+        if (wait_height > 0) {
+            pb_fill(x, graph_bottom - cpu_height - wait_height, bar_width - 1, wait_height, 0xFFC00000);
+        }
+    }
+
+    // The first two lines are left for SDL_XGU_SHOW_FPS
+    char pb_text[256];
+    SDL_snprintf(pb_text, sizeof(pb_text),
+                 "\n\n"
+                 "Draws: %d (%d merged)\n"
+                 "State: %d (B%d S%d T%d V%d C%d A%d)\n"
+                 "Vertices: %uKB Push: %uKB\n"
+                 "Uploads: %d Swizzled: %uKB\n"
+                 "Queue: %.02fms Wait: %.02fms\n",
+                 stats->draw_calls, stats->merged_draws, state_changes,
+                 stats->state_changes[XGU_STATE_BLEND], stats->state_changes[XGU_STATE_SHADER],
+                 stats->state_changes[XGU_STATE_TEXTURE], stats->state_changes[XGU_STATE_VIEWPORT],
+                 stats->state_changes[XGU_STATE_COLOR], stats->state_changes[XGU_STATE_VERTEX_ARRAY],
+                 (unsigned int)(stats->vertex_bytes / 1024), (unsigned int)(stats->pushbuffer_bytes / 1024),
+                 stats->texture_uploads, (unsigned int)(stats->swizzled_bytes / 1024),
+                 stats->command_queue_ns / 1e6f, render_data->present_wait_ns / 1e6f);
+
+    pb_erase_text_screen();
+    pb_fill(20, 65, 40 * 10, 5 * 20, 0xFF000000);
+    pb_print(pb_text);
+    pb_draw_text_screen();
+}
+#endif
+
+// Publishes the counters of the frame that is about to be presented as renderer properties, then resets them
+static void stats_publish(SDL_Renderer *renderer)
+{
+    xgu_render_data_t *render_data = (xgu_render_data_t *)renderer->internal;
+    xgu_frame_stats_t *stats = &render_data->stats;
+    SDL_PropertiesID props = SDL_GetRendererProperties(renderer);
+
+    stats->pushbuffer_bytes = push_dwords * sizeof(uint32_t);
+    push_dwords = 0;
+
+    int state_changes = 0;
+    for (int i = 0; i < XGU_STATE_TYPE_COUNT; i++) {
+        state_changes += stats->state_changes[i];
+    }
+
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_DRAW_CALLS_NUMBER, stats->draw_calls);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_MERGED_DRAWS_NUMBER, stats->merged_draws);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_STATE_CHANGES_NUMBER, state_changes);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_BLEND_CHANGES_NUMBER, stats->state_changes[XGU_STATE_BLEND]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_SHADER_CHANGES_NUMBER, stats->state_changes[XGU_STATE_SHADER]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_TEXTURE_CHANGES_NUMBER, stats->state_changes[XGU_STATE_TEXTURE]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_VIEWPORT_CHANGES_NUMBER, stats->state_changes[XGU_STATE_VIEWPORT]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_COLOR_CHANGES_NUMBER, stats->state_changes[XGU_STATE_COLOR]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_VERTEX_ARRAY_CHANGES_NUMBER, stats->state_changes[XGU_STATE_VERTEX_ARRAY]);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_VERTEX_BYTES_NUMBER, stats->vertex_bytes);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_PUSHBUFFER_BYTES_NUMBER, stats->pushbuffer_bytes);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_TEXTURE_UPLOADS_NUMBER, stats->texture_uploads);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_PALETTE_UPLOADS_NUMBER, stats->palette_uploads);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_SWIZZLED_BYTES_NUMBER, stats->swizzled_bytes);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_COMMAND_QUEUE_NS_NUMBER, stats->command_queue_ns);
+    SDL_SetNumberProperty(props, SDL_PROP_RENDERER_XGU_COMPRESSED_BYTES_SAVED_NUMBER, render_data->compressed_saving);
+
+#if SDL_XGU_SHOW_STATS
+    stats_draw(render_data, stats, state_changes);
+#endif
+
+    SDL_zerop(stats);
+}
+
 #if SDL_XGU_SHOW_FPS
 static uint64_t frame_start;
 static uint64_t frame_time = 0;
@@ -1321,4 +3467,369 @@ static void calculate_fps(int stage)
 }
 #endif
 
+// Returns the render data of renderer, or NULL with the error set if it isn't an XGU renderer
+static xgu_render_data_t *get_render_data(SDL_Renderer *renderer)
+{
+    const char *name = SDL_GetRendererName(renderer);
+    if (name == NULL) {
+        return NULL;
+    }
+    if (SDL_strcmp(name, nxdk_RenderDriver.name) != 0) {
+        SDL_SetError("[nxdk renderer] Renderer is not %s", nxdk_RenderDriver.name);
+        return NULL;
+    }
+    return (xgu_render_data_t *)renderer->internal;
+}
+
+bool SDL_XGU_RenderReadPixelsAsync(SDL_Renderer *renderer, const SDL_Rect *rect,
+                                   SDL_XGU_ReadPixelsCallback callback, void *userdata)
+{
+    xgu_render_data_t *render_data = get_render_data(renderer);
+    if (render_data == NULL) {
+        return false;
+    }
+    if (callback == NULL) {
+        return SDL_InvalidParamError("callback");
+    }
+
+    SDL_Texture *target = renderer->target;
+
+    SDL_Rect bounds = { 0, 0, pb_back_buffer_width(), pb_back_buffer_height() };
+    if (target) {
+        bounds.w = target->w;
+        bounds.h = target->h;
+    }
+
+    SDL_Rect read_rect = bounds;
+    if (rect && !SDL_GetRectIntersection(rect, &bounds, &read_rect)) {
+        return SDL_SetError("[nxdk renderer] Readback rect is outside the render target");
+    }
+
+    if (render_data->readback_count == render_data->readback_capacity) {
+        const int capacity = SDL_max(render_data->readback_capacity * 2, 4);
+        xgu_readback_t *readbacks = (xgu_readback_t *)SDL_realloc(render_data->readbacks, capacity * sizeof(xgu_readback_t));
+        if (readbacks == NULL) {
+            return false;
+        }
+        render_data->readbacks = readbacks;
+        render_data->readback_capacity = capacity;
+    }
+
+    // Submit everything drawn so far, the pixels are read once the frame has finished on the GPU
+    if (!SDL_FlushRenderer(renderer)) {
+        return false;
+    }
+
+    xgu_readback_t *readback = &render_data->readbacks[render_data->readback_count++];
+    readback->rect = read_rect;
+    readback->source = (target) ? (const xgu_texture_t *)target->internal : NULL;
+    readback->back_buffer = pb_back_buffer();
+    readback->frame = render_data->frame_serial;
+    readback->format = (target) ? target->format : SDL_PIXELFORMAT_ARGB8888;
+    readback->callback = callback;
+    readback->userdata = userdata;
+    return true;
+}
+
+// Grows a heap array so it holds at least needed elements
+static bool grow_array(void **array, size_t *capacity, size_t needed, size_t element_size)
+{
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    const size_t new_capacity = SDL_max(*capacity * 2, SDL_max(needed, 16));
+    void *new_array = SDL_realloc(*array, new_capacity * element_size);
+    if (new_array == NULL) {
+        return false;
+    }
+    *array = new_array;
+    *capacity = new_capacity;
+    return true;
+}
+
+// Recording version of push_reserve. After running out of memory the rest of the recording is discarded.
+static void bundle_reserve(SDL_XGU_Bundle *bundle, size_t dwords)
+{
+    static uint32_t discard[SDL_XGU_PUSH_BLOCK_SIZE];
+
+    if (!bundle->failed) {
+        const size_t used = (push_block) ? (size_t)(p - bundle->commands) : bundle->command_count;
+        if (grow_array((void **)&bundle->commands, &bundle->command_capacity, used + dwords, sizeof(uint32_t))) {
+            p = bundle->commands + used;
+            push_block = p;
+            return;
+        }
+        bundle->failed = true;
+    }
+    p = discard;
+    push_block = p;
+}
+
+static void bundle_add_viewport_patch(SDL_XGU_Bundle *bundle, size_t index)
+{
+    if (bundle->failed) {
+        return;
+    }
+    if (!grow_array((void **)&bundle->viewport_patches, &bundle->viewport_patch_capacity,
+                    bundle->viewport_patch_count + 1, sizeof(size_t))) {
+        bundle->failed = true;
+        return;
+    }
+    bundle->viewport_patches[bundle->viewport_patch_count++] = index;
+}
+
+static void bundle_add_texture(SDL_XGU_Bundle *bundle, xgu_texture_t *xgu_texture, int palette_index)
+{
+    for (size_t i = 0; i < bundle->texture_count; i++) {
+        if (bundle->textures[i].texture == xgu_texture && bundle->textures[i].buffer_index == xgu_texture->buffer_index &&
+            bundle->textures[i].palette_index == palette_index) {
+            return;
+        }
+    }
+    if (!grow_array((void **)&bundle->textures, &bundle->texture_capacity, bundle->texture_count + 1,
+                    sizeof(xgu_bundle_texture_t))) {
+        bundle->failed = true;
+        return;
+    }
+    bundle->textures[bundle->texture_count].texture = xgu_texture;
+    bundle->textures[bundle->texture_count].buffer_index = xgu_texture->buffer_index;
+    bundle->textures[bundle->texture_count].palette_index = palette_index;
+    bundle->texture_count++;
+}
+
+static void bundles_detach_texture(xgu_render_data_t *render_data, const xgu_texture_t *xgu_texture)
+{
+    for (SDL_XGU_Bundle *bundle = render_data->bundles; bundle; bundle = bundle->next) {
+        for (size_t i = 0; i < bundle->texture_count && !bundle->detached; i++) {
+            bundle->detached = (bundle->textures[i].texture == xgu_texture);
+        }
+    }
+}
+
+// Bundle vertices live as long as the bundle, so they come from the bundle's own chunks instead of the vertex arena
+static void *bundle_allocate_vertices(SDL_XGU_Bundle *bundle, size_t size, size_t alignment, size_t *vertex_data_offset)
+{
+    xgu_arena_chunk_t *chunk = bundle->vertex_chunks;
+    size_t start_offset = (bundle->vertex_offset + alignment - 1) & ~(alignment - 1);
+
+    if (chunk == NULL || start_offset + size > chunk->size) {
+        chunk = (xgu_arena_chunk_t *)SDL_calloc(1, sizeof(xgu_arena_chunk_t));
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->size = SDL_max(size, SDL_XGU_BUNDLE_VERTEX_CHUNK_SIZE);
+        chunk->data = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, chunk->size);
+        if (chunk->data == NULL) {
+            SDL_free(chunk);
+            return NULL;
+        }
+        chunk->next = bundle->vertex_chunks;
+        bundle->vertex_chunks = chunk;
+        start_offset = 0;
+    }
+
+    void *ptr = chunk->data + start_offset;
+    bundle->vertex_offset = start_offset + size;
+    *vertex_data_offset = (size_t)(uintptr_t)ptr;
+    return ptr;
+}
+
+bool SDL_XGU_BeginBundle(SDL_Renderer *renderer)
+{
+    xgu_render_data_t *render_data = get_render_data(renderer);
+    if (render_data == NULL) {
+        return false;
+    }
+    if (render_data->recording) {
+        return SDL_SetError("[nxdk renderer] A bundle is already being recorded");
+    }
+
+    // Anything queued before recording starts is rendered as normal
+    if (!SDL_FlushRenderer(renderer)) {
+        return false;
+    }
+
+    SDL_XGU_Bundle *bundle = (SDL_XGU_Bundle *)SDL_calloc(1, sizeof(SDL_XGU_Bundle));
+    if (bundle == NULL) {
+        return false;
+    }
+    bundle->renderer = renderer;
+    bundle->next = render_data->bundles;
+    render_data->bundles = bundle;
+    render_data->recording = bundle;
+
+    // The bundle can be drawn whatever state the GPU is in, so every register it uses must be set inside it
+    state_invalidate(render_data);
+    return true;
+}
+
+SDL_XGU_Bundle *SDL_XGU_EndBundle(SDL_Renderer *renderer)
+{
+    xgu_render_data_t *render_data = get_render_data(renderer);
+    if (render_data == NULL) {
+        return NULL;
+    }
+    if (render_data->recording == NULL) {
+        SDL_SetError("[nxdk renderer] No bundle is being recorded");
+        return NULL;
+    }
+
+    // Running the command queue records it into the bundle
+    const bool flushed = SDL_FlushRenderer(renderer);
+    SDL_XGU_Bundle *bundle = render_data->recording;
+    render_data->recording = NULL;
+
+    // The shadow followed the recorded commands, not the GPU
+    state_invalidate(render_data);
+
+    if (!flushed || bundle->failed || bundle->cleared || bundle->detached) {
+        if (bundle->cleared) {
+            SDL_SetError("[nxdk renderer] SDL_RenderClear can't be recorded into bundles");
+        } else if (bundle->detached) {
+            SDL_SetError("[nxdk renderer] A texture drawn by the bundle was destroyed while recording");
+        } else if (bundle->failed) {
+            SDL_OutOfMemory();
+        }
+        SDL_XGU_DestroyBundle(bundle);
+        return NULL;
+    }
+    return bundle;
+}
+
+bool SDL_XGU_RenderBundle(SDL_Renderer *renderer, SDL_XGU_Bundle *bundle, float x, float y)
+{
+    xgu_render_data_t *render_data = get_render_data(renderer);
+    if (render_data == NULL) {
+        return false;
+    }
+    if (bundle == NULL || bundle->renderer != renderer) {
+        return SDL_InvalidParamError("bundle");
+    }
+    if (render_data->recording) {
+        return SDL_SetError("[nxdk renderer] Bundles can't be drawn while a bundle is being recorded");
+    }
+    if (bundle->detached) {
+        return SDL_SetError("[nxdk renderer] A texture drawn by the bundle was destroyed");
+    }
+
+    // Draws queued before the bundle must be pushed before it
+    if (!SDL_FlushRenderer(renderer)) {
+        return false;
+    }
+
+    if (render_data->active_render_target) {
+        readbacks_settle(render_data, render_data->active_render_target);
+    }
+
+    // Copied one method at a time so that pbkit never splits a method between two pushbuffer blocks
+    capture_set_tag(XGU_CAPTURE_TAG_BUNDLE);
+    size_t index = 0;
+    size_t patch = 0;
+    while (index < bundle->command_count) {
+        const size_t method_dwords = 1 + state_shadow_method_count(bundle->commands[index]);
+        push_reserve(method_dwords);
+        SDL_memcpy(p, &bundle->commands[index], method_dwords * sizeof(uint32_t));
+
+        while (patch < bundle->viewport_patch_count && bundle->viewport_patches[patch] < index + method_dwords) {
+            const size_t patch_index = bundle->viewport_patches[patch++];
+            float offset[2];
+            SDL_memcpy(offset, &bundle->commands[patch_index], sizeof(offset));
+            offset[0] += x;
+            offset[1] += y;
+            SDL_memcpy(p + (patch_index - index), offset, sizeof(offset));
+        }
+
+        p += method_dwords;
+        index += method_dwords;
+    }
+    push_flush();
+    capture_set_tag(XGU_CAPTURE_TAG_OTHER);
+    render_data->render_target_written = true;
+
+    for (size_t i = 0; i < bundle->texture_count; i++) {
+        xgu_bundle_texture_t *bundle_texture = &bundle->textures[i];
+        bundle_texture->texture->buffers[bundle_texture->buffer_index].last_used_frame = render_data->frame_serial;
+        if (bundle_texture->texture->atlas_page) {
+            bundle_texture->texture->atlas_page->last_used_frame = render_data->frame_serial;
+        }
+        if (bundle_texture->texture->palettes) {
+            bundle_texture->texture->palettes[bundle_texture->palette_index].last_used_frame = render_data->frame_serial;
+        }
+    }
+    bundle->last_used_frame = render_data->frame_serial;
+
+    // The bundle left the GPU in whatever state its last commands set
+    state_invalidate(render_data);
+    return true;
+}
+
+void SDL_XGU_DestroyBundle(SDL_XGU_Bundle *bundle)
+{
+    if (bundle == NULL) {
+        return;
+    }
+
+    // The GPU may still be reading the bundle's vertices
+    xgu_render_data_t *render_data = (xgu_render_data_t *)bundle->renderer->internal;
+    if (frame_in_flight(render_data, bundle->last_used_frame)) {
+        while (pb_busy()) {
+            Sleep(0);
+        }
+    }
+
+    while (bundle->vertex_chunks) {
+        xgu_arena_chunk_t *chunk = bundle->vertex_chunks;
+        bundle->vertex_chunks = chunk->next;
+        contiguous_heap_free(chunk->data);
+        SDL_free(chunk);
+    }
+    SDL_XGU_Bundle **link = &render_data->bundles;
+    while (*link != bundle) {
+        link = &(*link)->next;
+    }
+    *link = bundle->next;
+
+    SDL_free(bundle->commands);
+    SDL_free(bundle->viewport_patches);
+    SDL_free(bundle->textures);
+    SDL_free(bundle);
+}
+
+
+bool SDL_XGU_CapturePushbuffer(SDL_Renderer *renderer, const char *file, int frames)
+{
+    if (get_render_data(renderer) == NULL) {
+        return false;
+    }
+    if (file == NULL) {
+        return SDL_InvalidParamError("file");
+    }
+    if (frames <= 0) {
+        return SDL_InvalidParamError("frames");
+    }
+    if (capture_io || capture_pending_io) {
+        return SDL_SetError("[nxdk renderer] A pushbuffer capture is already running");
+    }
+
+    SDL_IOStream *io = SDL_IOFromFile(file, "wb");
+    if (io == NULL) {
+        return false;
+    }
+    const xgu_capture_header_t header = {
+        .magic = XGU_CAPTURE_MAGIC,
+        .version = XGU_CAPTURE_VERSION,
+    };
+    if (SDL_WriteIO(io, &header, sizeof(header)) != sizeof(header)) {
+        SDL_CloseIO(io);
+        return false;
+    }
+
+    capture_pending_io = io;
+    capture_frames_left = frames;
+    capture_frame = 0;
+    capture_tag = XGU_CAPTURE_TAG_OTHER;
+    return true;
+}
+
 #endif // SDL_VIDEO_RENDER_XGU
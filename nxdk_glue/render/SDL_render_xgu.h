@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#ifndef SDL_render_xgu_h_
+#define SDL_render_xgu_h_
+
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_surface.h>
+
+// Number of frames SDL_RenderPresent lets the GPU fall behind the CPU before it waits, from 0 to 2. 0 waits for
+// every frame to finish rendering. Lower values reduce input latency, higher values let the CPU and GPU
+// overlap more. The default is 2. Set as a renderer creation property, or with the hint below.
+#define SDL_PROP_RENDERER_CREATE_XGU_FRAMES_IN_FLIGHT_NUMBER "SDL.renderer.create.xgu.frames_in_flight"
+#define SDL_HINT_RENDER_XGU_FRAMES_IN_FLIGHT "SDL_RENDER_XGU_FRAMES_IN_FLIGHT"
+
+// Packs small static textures into shared swizzled atlas pages. This saves the memory lost to rounding each texture
+// up to a power of two, and lets draws that use different textures on the same page be merged. Textures in the
+// atlas are always clamped, never wrapped. Disabled by default. Set as a renderer creation property, or with
+// the hint below.
+#define SDL_PROP_RENDERER_CREATE_XGU_TEXTURE_ATLAS_BOOLEAN "SDL.renderer.create.xgu.texture_atlas"
+#define SDL_HINT_RENDER_XGU_TEXTURE_ATLAS "SDL_RENDER_XGU_TEXTURE_ATLAS"
+
+// Texture creation property. Set to false to keep a small static texture out of the atlas, for example
+// because it is drawn with SDL_TEXTURE_ADDRESS_WRAP.
+#define SDL_PROP_TEXTURE_CREATE_XGU_ATLAS_BOOLEAN "SDL.texture.create.xgu.atlas"
+
+// Texture creation properties for precompressed DXT textures, which the NV2A samples natively. Set the format to
+// one of SDL_XGU_CompressedFormat and optionally the data to the compressed blocks, as rows of 4x4 blocks from top
+// to bottom with no padding between rows. tools/xgu_dxt_encode.c produces this data. The texture must be static and
+// the SDL pixel format it is created with is ignored, so use any supported format such as SDL_PIXELFORMAT_ARGB8888.
+// SDL_UpdateTexture on a compressed texture takes blocks in the same layout with pitch being the bytes per row of
+// blocks, and rect must be aligned to 4x4 blocks.
+#define SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_FORMAT_NUMBER "SDL.texture.create.xgu.compressed_format"
+#define SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_DATA_POINTER  "SDL.texture.create.xgu.compressed_data"
+
+typedef enum SDL_XGU_CompressedFormat
+{
+    SDL_XGU_COMPRESSED_NONE,
+    SDL_XGU_COMPRESSED_DXT1, // 8 bytes per block, RGB with optional 1-bit alpha
+    SDL_XGU_COMPRESSED_DXT3, // 16 bytes per block, RGB with explicit 4-bit alpha
+    SDL_XGU_COMPRESSED_DXT5, // 16 bytes per block, RGB with interpolated alpha
+} SDL_XGU_CompressedFormat;
+
+// Renderer properties specific to the nxdk XGU renderer. These are read with
+// SDL_GetNumberProperty(SDL_GetRendererProperties(renderer), ...) and are updated
+// once per frame in SDL_RenderPresent.
+
+// Number of draws pushed to the GPU during the last frame, after merging
+#define SDL_PROP_RENDERER_XGU_DRAW_CALLS_NUMBER "SDL.renderer.xgu.draw_calls"
+
+// Number of geometry draws that were merged into a preceding draw during the last frame
+#define SDL_PROP_RENDERER_XGU_MERGED_DRAWS_NUMBER "SDL.renderer.xgu.merged_draws"
+
+// Number of NV097 state methods pushed during the last frame, in total and for each kind of state.
+// Methods that would not change a register are not pushed and are not counted.
+#define SDL_PROP_RENDERER_XGU_STATE_CHANGES_NUMBER        "SDL.renderer.xgu.state_changes"
+#define SDL_PROP_RENDERER_XGU_BLEND_CHANGES_NUMBER        "SDL.renderer.xgu.blend_changes"
+#define SDL_PROP_RENDERER_XGU_SHADER_CHANGES_NUMBER       "SDL.renderer.xgu.shader_changes"
+#define SDL_PROP_RENDERER_XGU_TEXTURE_CHANGES_NUMBER      "SDL.renderer.xgu.texture_changes"
+#define SDL_PROP_RENDERER_XGU_VIEWPORT_CHANGES_NUMBER     "SDL.renderer.xgu.viewport_changes"
+#define SDL_PROP_RENDERER_XGU_COLOR_CHANGES_NUMBER        "SDL.renderer.xgu.color_changes"
+#define SDL_PROP_RENDERER_XGU_VERTEX_ARRAY_CHANGES_NUMBER "SDL.renderer.xgu.vertex_array_changes"
+
+// Bytes of vertex data queued during the last frame
+#define SDL_PROP_RENDERER_XGU_VERTEX_BYTES_NUMBER "SDL.renderer.xgu.vertex_bytes"
+
+// Bytes of pushbuffer written while running the command queue and drawing bundles during the last frame
+#define SDL_PROP_RENDERER_XGU_PUSHBUFFER_BYTES_NUMBER "SDL.renderer.xgu.pushbuffer_bytes"
+
+// Number of texture updates and locks during the last frame, and the bytes swizzled by them
+#define SDL_PROP_RENDERER_XGU_TEXTURE_UPLOADS_NUMBER "SDL.renderer.xgu.texture_uploads"
+#define SDL_PROP_RENDERER_XGU_SWIZZLED_BYTES_NUMBER  "SDL.renderer.xgu.swizzled_bytes"
+
+// Number of INDEX8 texture palettes copied to the GPU during the last frame. A palette is copied when a texture
+// is drawn after its SDL palette was changed.
+#define SDL_PROP_RENDERER_XGU_PALETTE_UPLOADS_NUMBER "SDL.renderer.xgu.palette_uploads"
+
+// Nanoseconds of CPU time spent running the command queue during the last frame
+#define SDL_PROP_RENDERER_XGU_COMMAND_QUEUE_NS_NUMBER "SDL.renderer.xgu.command_queue_ns"
+
+// Bytes of texture memory saved by the DXT compressed textures that currently exist, compared to storing them
+// with 32 bits per pixel
+#define SDL_PROP_RENDERER_XGU_COMPRESSED_BYTES_SAVED_NUMBER "SDL.renderer.xgu.compressed_bytes_saved"
+
+// Write-combined contiguous memory in use by textures, the vertex arena and audio buffers, in bytes
+#define SDL_PROP_RENDERER_XGU_HEAP_BYTES_USED_NUMBER "SDL.renderer.xgu.heap_bytes_used"
+
+// Highest value of SDL_PROP_RENDERER_XGU_HEAP_BYTES_USED_NUMBER since startup
+#define SDL_PROP_RENDERER_XGU_HEAP_BYTES_PEAK_NUMBER "SDL.renderer.xgu.heap_bytes_peak"
+
+// Percentage of free heap memory that is not part of the largest free chunk
+#define SDL_PROP_RENDERER_XGU_HEAP_FRAGMENTATION_NUMBER "SDL.renderer.xgu.heap_fragmentation"
+
+// Nanoseconds the CPU spent blocked in the previous SDL_RenderPresent, waiting for a back buffer to be flipped or
+// for the GPU to finish the oldest frame in flight
+#define SDL_PROP_RENDERER_XGU_PRESENT_WAIT_NS_NUMBER "SDL.renderer.xgu.present_wait_ns"
+
+// Time of the most recent vblank in SDL_GetTicksNS() nanoseconds. SDL_RenderPresent never waits for vblank itself.
+// The time is measured when it has to wait for a back buffer to be flipped, and otherwise estimated from pbkit's
+// vblank counter and the refresh period.
+#define SDL_PROP_RENDERER_XGU_VBLANK_NS_NUMBER "SDL.renderer.xgu.vblank_ns"
+
+// Nanoseconds between vblanks for the current video mode
+#define SDL_PROP_RENDERER_XGU_REFRESH_PERIOD_NS_NUMBER "SDL.renderer.xgu.refresh_period_ns"
+
+// Largest size the vertex arena has grown to, in bytes. The arena grows when a frame needs more vertex
+// memory than is free and gives unused chunks back after a number of quiet frames.
+#define SDL_PROP_RENDERER_XGU_VERTEX_ARENA_HIGH_WATER_NUMBER "SDL.renderer.xgu.vertex_arena_high_water"
+
+// Called with the pixels of an SDL_XGU_RenderReadPixelsAsync request. The callback owns the surface and must
+// free it with SDL_DestroySurface. surface is NULL if the readback failed, SDL_GetError() has the reason.
+typedef void (SDLCALL *SDL_XGU_ReadPixelsCallback)(void *userdata, SDL_Surface *surface);
+
+// Queues a read of rect from the current render target without stalling the render loop. rect is in pixels of
+// the render target, or NULL for the whole target. The pixels are read once the current frame has finished
+// rendering, so they include everything drawn during the frame, and callback is called from a later
+// SDL_RenderPresent. SDL_RenderPresent never waits for a readback. If a texture render target is drawn to or
+// updated in a later frame before its readback has completed, the readback completes first, waiting for its frame,
+// and callback is called from that render call instead.
+extern bool SDL_XGU_RenderReadPixelsAsync(SDL_Renderer *renderer, const SDL_Rect *rect,
+                                          SDL_XGU_ReadPixelsCallback callback, void *userdata);
+
+// Bundles record SDL render calls once so that static layers, like a HUD or a menu background, can be drawn
+// every frame without packing their vertices or building their pushbuffer commands again.
+// Everything drawn between SDL_XGU_BeginBundle and SDL_XGU_EndBundle is recorded instead of rendered.
+// Render target changes are not recorded, and calling SDL_RenderClear while recording makes SDL_XGU_EndBundle fail.
+// Textures drawn by a bundle must not be updated or have their palette changed while the bundle exists. Once one of
+// them is destroyed, SDL_XGU_RenderBundle fails. Bundles must be destroyed before their renderer.
+typedef struct SDL_XGU_Bundle SDL_XGU_Bundle;
+
+extern bool SDL_XGU_BeginBundle(SDL_Renderer *renderer);
+
+// Returns the recorded bundle, or NULL on failure
+extern SDL_XGU_Bundle *SDL_XGU_EndBundle(SDL_Renderer *renderer);
+
+// Draws a bundle to the current render target, moved by x and y pixels. Clip rects are not moved.
+extern bool SDL_XGU_RenderBundle(SDL_Renderer *renderer, SDL_XGU_Bundle *bundle, float x, float y);
+
+extern void SDL_XGU_DestroyBundle(SDL_XGU_Bundle *bundle);
+
+// Writes every pushbuffer segment the renderer pushes during the next frames to file, for off-device analysis
+// with tools/xgu_capture_analyze.c. Each segment is tagged with the SDL render command that pushed it. The
+// capture starts with the frame after the next SDL_RenderPresent and lasts for the given number of frames. The format is described in xgu_capture.h.
+// Clears and the FPS and stats overlays are drawn by pbkit and are not captured.
+extern bool SDL_XGU_CapturePushbuffer(SDL_Renderer *renderer, const char *file, int frames);
+
+#endif /* SDL_render_xgu_h_ */
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#include <assert.h>
+
+#include "state_shadow.h"
+
+static inline bool state_matches(const xgu_state_shadow_t *shadow, uint32_t reg, uint32_t value)
+{
+    return (shadow->valid[reg / 32] & (1U << (reg % 32))) && shadow->value[reg] == value;
+}
+
+bool state_shadow_update(xgu_state_shadow_t *shadow, uint32_t header, const uint32_t *values)
+{
+    const uint32_t reg = (header & XGU_METHOD_MASK) >> 2;
+    const uint32_t count = state_shadow_method_count(header);
+
+    assert(!(header & XGU_METHOD_NON_INCREASING) && reg + count <= XGU_STATE_REGISTER_COUNT);
+
+    uint32_t i = 0;
+    while (i < count && state_matches(shadow, reg + i, values[i])) {
+        i++;
+    }
+    if (i == count) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        shadow->value[reg + i] = values[i];
+        shadow->valid[(reg + i) / 32] |= 1U << ((reg + i) % 32);
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#ifndef STATE_SHADOW_H
+#define STATE_SHADOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Shadow of the NV097 register state the XGU renderer has pushed. This file has no nxdk or SDL dependencies so
+// that the state filtering can be built and measured on a host machine.
+
+// Fields of a pushbuffer method header, as written by pb_push1 and the xgu helpers
+#define XGU_METHOD_MASK           0x1FFC
+#define XGU_METHOD_COUNT_SHIFT    18
+#define XGU_METHOD_COUNT_MASK     0x7FF
+#define XGU_METHOD_NON_INCREASING 0x40000000
+#define XGU_STATE_REGISTER_COUNT  ((XGU_METHOD_MASK >> 2) + 1)
+
+// The last value the renderer pushed for every NV097 register, indexed by method / 4. Register state goes
+// through state_push so methods that would not change anything are never emitted.
+typedef struct xgu_state_shadow
+{
+    uint32_t value[XGU_STATE_REGISTER_COUNT];
+    uint32_t valid[XGU_STATE_REGISTER_COUNT / 32]; // Cleared when the GPU may no longer match value
+} xgu_state_shadow_t;
+
+static inline uint32_t state_shadow_method_count(uint32_t header)
+{
+    return (header >> XGU_METHOD_COUNT_SHIFT) & XGU_METHOD_COUNT_MASK;
+}
+
+// Returns false if the method with this header and values would leave every register it writes unchanged.
+// Otherwise the shadow is updated to the new values and true is returned. The method must write registers in
+// increasing order.
+bool state_shadow_update(xgu_state_shadow_t *shadow, uint32_t header, const uint32_t *values);
+
+// Makes the next update of this method report a change, whatever its value
+static inline void state_shadow_forget(xgu_state_shadow_t *shadow, uint32_t method)
+{
+    const uint32_t reg = (method & XGU_METHOD_MASK) >> 2;
+    shadow->valid[reg / 32] &= ~(1U << (reg % 32));
+}
+
+static inline void state_shadow_invalidate(xgu_state_shadow_t *shadow)
+{
+    memset(shadow->valid, 0, sizeof(shadow->valid));
+}
+
+#endif
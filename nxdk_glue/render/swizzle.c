@@ -27,6 +27,10 @@
 
 #include "swizzle.h"
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 /*
  * Helpers for converting to and from swizzled (Z-ordered) texture formats.
  * Swizzled textures store pixels in a more cache-friendly layout for rendering
@@ -81,6 +85,218 @@ static void generate_swizzle_masks(unsigned int width,
     *mask_z = z;
 }
 
+/*
+ * Scatter the low bits of value into the set bits of mask. This gives the swizzled offset
+ * of a linear coordinate, e.g. deposit_bits(x, mask_x).
+ */
+static inline uint32_t deposit_bits(uint32_t value, uint32_t mask)
+{
+    uint32_t result = 0;
+    for (uint32_t bit = 1; mask != 0; bit <<= 1) {
+        const uint32_t lowest = mask & (~mask + 1);
+        if (value & bit) {
+            result |= lowest;
+        }
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+/*
+ * 2D textures of at least 4x4 pixels are moved in 4x4 tiles. The lowest four bits of a
+ * swizzled offset are then always "yxyx", so each tile is 16 consecutive pixels in the
+ * swizzled texture, visited in the order:
+ * (0,0)(1,0)(0,1)(1,1) (2,0)(3,0)(2,1)(3,1) (0,2)(1,2)(0,3)(1,3) (2,2)(3,2)(2,3)(3,3)
+ * Horizontally adjacent pixel pairs stay together so they can be moved as one unit.
+ */
+#define TILE_SIZE      4
+#define TILE_MAX_COUNT (4096 / TILE_SIZE)
+
+/*
+ * rect_internal is too large to be inlined into every caller, so bytes_per_pixel is not a
+ * constant inside it. Switch to a fixed size copy so the common sizes are single moves
+ * instead of calls to memcpy.
+ */
+static inline void copy_bytes(uint8_t *dst, const uint8_t *src, unsigned int size)
+{
+    switch (size) {
+    case 1:
+        *dst = *src;
+        break;
+    case 2:
+        memcpy(dst, src, 2);
+        break;
+    case 4:
+        memcpy(dst, src, 4);
+        break;
+    case 8:
+        memcpy(dst, src, 8);
+        break;
+    default:
+        memcpy(dst, src, size);
+    }
+}
+
+static inline void swizzle_tile(const uint8_t *src, unsigned int row_pitch, uint8_t *dst,
+                                unsigned int bytes_per_pixel)
+{
+#ifdef __SSE__
+    if (bytes_per_pixel == 4) {
+        for (int row = 0; row < TILE_SIZE; row += 2) {
+            const __m128 row0 = _mm_loadu_ps((const float *)(src + row * row_pitch));
+            const __m128 row1 = _mm_loadu_ps((const float *)(src + (row + 1) * row_pitch));
+            _mm_storeu_ps((float *)(dst + row * 16), _mm_movelh_ps(row0, row1));
+            _mm_storeu_ps((float *)(dst + row * 16 + 16), _mm_movehl_ps(row1, row0));
+        }
+        return;
+    }
+#endif
+    const unsigned int pair = 2 * bytes_per_pixel;
+    for (int row = 0; row < TILE_SIZE; row += 2) {
+        const uint8_t *row0 = src + row * row_pitch;
+        const uint8_t *row1 = row0 + row_pitch;
+        copy_bytes(dst + 0 * pair, row0, pair);
+        copy_bytes(dst + 1 * pair, row1, pair);
+        copy_bytes(dst + 2 * pair, row0 + pair, pair);
+        copy_bytes(dst + 3 * pair, row1 + pair, pair);
+        dst += 4 * pair;
+    }
+}
+
+static inline void unswizzle_tile(const uint8_t *src, uint8_t *dst, unsigned int row_pitch,
+                                  unsigned int bytes_per_pixel)
+{
+#ifdef __SSE__
+    if (bytes_per_pixel == 4) {
+        for (int row = 0; row < TILE_SIZE; row += 2) {
+            const __m128 lo = _mm_loadu_ps((const float *)(src + row * 16));
+            const __m128 hi = _mm_loadu_ps((const float *)(src + row * 16 + 16));
+            _mm_storeu_ps((float *)(dst + row * row_pitch), _mm_movelh_ps(lo, hi));
+            _mm_storeu_ps((float *)(dst + (row + 1) * row_pitch), _mm_movehl_ps(hi, lo));
+        }
+        return;
+    }
+#endif
+    const unsigned int pair = 2 * bytes_per_pixel;
+    for (int row = 0; row < TILE_SIZE; row += 2) {
+        uint8_t *row0 = dst + row * row_pitch;
+        uint8_t *row1 = row0 + row_pitch;
+        copy_bytes(row0, src + 0 * pair, pair);
+        copy_bytes(row1, src + 1 * pair, pair);
+        copy_bytes(row0 + pair, src + 2 * pair, pair);
+        copy_bytes(row1 + pair, src + 3 * pair, pair);
+        src += 4 * pair;
+    }
+}
+
+/*
+ * Move the pixels in [x0, x1) x [y0, y1) of the texture one at a time. linear_buf holds
+ * the pixel at (rect_x, rect_y). Used for pixels that don't fill a whole tile.
+ */
+static inline void move_pixels(
+    uint8_t *linear_buf,
+    uint8_t *swizzled_buf,
+    unsigned int rect_x, unsigned int rect_y,
+    unsigned int x0, unsigned int x1,
+    unsigned int y0, unsigned int y1,
+    unsigned int row_pitch,
+    unsigned int bytes_per_pixel,
+    uint32_t mask_x, uint32_t mask_y,
+    bool to_swizzled)
+{
+    /* Most calls are for empty edges, skip working out their offsets */
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    uint32_t off_y = deposit_bits(y0, mask_y);
+    for (unsigned int y = y0; y < y1; y++) {
+        uint32_t off_x = deposit_bits(x0, mask_x);
+        for (unsigned int x = x0; x < x1; x++) {
+            uint8_t *linear = linear_buf + (y - rect_y) * row_pitch + (x - rect_x) * bytes_per_pixel;
+            uint8_t *swizzled = swizzled_buf + (off_x + off_y) * bytes_per_pixel;
+            if (to_swizzled) {
+                copy_bytes(swizzled, linear, bytes_per_pixel);
+            } else {
+                copy_bytes(linear, swizzled, bytes_per_pixel);
+            }
+            off_x = (off_x - mask_x) & mask_x;
+        }
+        off_y = (off_y - mask_y) & mask_y;
+    }
+}
+
+/*
+ * Move the rect [x, x + width) x [y, y + height) between a linear buffer, which holds only
+ * the rect, and a swizzled texture of tex_width x tex_height. The work done depends only
+ * on the size of the rect, not of the texture.
+ */
+static inline void rect_internal(
+    uint8_t *linear_buf,
+    unsigned int row_pitch,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    uint8_t *swizzled_buf,
+    unsigned int tex_width,
+    unsigned int tex_height,
+    unsigned int bytes_per_pixel,
+    bool to_swizzled)
+{
+    uint32_t mask_x, mask_y, mask_z;
+    generate_swizzle_masks(tex_width, tex_height, 1, &mask_x, &mask_y, &mask_z);
+
+    /* Whole tiles covered by the rect. Tiles need the "yxyx" low bits so at least a 4x4 texture */
+    unsigned int tile_x0 = x, tile_x1 = x, tile_y0 = y, tile_y1 = y;
+    if (tex_width >= TILE_SIZE && tex_height >= TILE_SIZE &&
+        tex_width <= TILE_SIZE * TILE_MAX_COUNT && tex_height <= TILE_SIZE * TILE_MAX_COUNT) {
+        const unsigned int x0 = (x + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+        const unsigned int x1 = (x + width) & ~(TILE_SIZE - 1);
+        const unsigned int y0 = (y + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+        const unsigned int y1 = (y + height) & ~(TILE_SIZE - 1);
+        if (x0 < x1 && y0 < y1) {
+            tile_x0 = x0, tile_x1 = x1, tile_y0 = y0, tile_y1 = y1;
+        }
+    }
+
+    if (tile_x0 < tile_x1) {
+        const unsigned int tiles_x = (tile_x1 - tile_x0) / TILE_SIZE;
+        const unsigned int tile_bytes = TILE_SIZE * bytes_per_pixel;
+
+        /* Swizzled offset of the first pixel of each tile column */
+        uint32_t tile_offset_x[TILE_MAX_COUNT];
+        for (unsigned int tx = 0; tx < tiles_x; tx++) {
+            tile_offset_x[tx] = deposit_bits(tile_x0 + tx * TILE_SIZE, mask_x);
+        }
+
+        for (unsigned int ty = tile_y0; ty < tile_y1; ty += TILE_SIZE) {
+            const uint32_t tile_offset_y = deposit_bits(ty, mask_y);
+            uint8_t *linear = linear_buf + (ty - y) * row_pitch + (tile_x0 - x) * bytes_per_pixel;
+            for (unsigned int tx = 0; tx < tiles_x; tx++) {
+                uint8_t *swizzled = swizzled_buf + (tile_offset_x[tx] + tile_offset_y) * bytes_per_pixel;
+                if (to_swizzled) {
+                    swizzle_tile(linear, row_pitch, swizzled, bytes_per_pixel);
+                } else {
+                    unswizzle_tile(swizzled, linear, row_pitch, bytes_per_pixel);
+                }
+                linear += tile_bytes;
+            }
+        }
+    }
+
+    /* Rows above and below the tiles, then the columns either side of them */
+    const unsigned int x_end = x + width, y_end = y + height;
+    move_pixels(linear_buf, swizzled_buf, x, y, x, x_end, y, tile_y0,
+                row_pitch, bytes_per_pixel, mask_x, mask_y, to_swizzled);
+    move_pixels(linear_buf, swizzled_buf, x, y, x, x_end, tile_y1, y_end,
+                row_pitch, bytes_per_pixel, mask_x, mask_y, to_swizzled);
+    move_pixels(linear_buf, swizzled_buf, x, y, x, tile_x0, tile_y0, tile_y1,
+                row_pitch, bytes_per_pixel, mask_x, mask_y, to_swizzled);
+    move_pixels(linear_buf, swizzled_buf, x, y, tile_x1, x_end, tile_y0, tile_y1,
+                row_pitch, bytes_per_pixel, mask_x, mask_y, to_swizzled);
+}
+
 static inline void swizzle_box_internal(
     const uint8_t *src_buf,
     unsigned int width,
@@ -91,6 +307,12 @@ static inline void swizzle_box_internal(
     unsigned int slice_pitch,
     unsigned int bytes_per_pixel)
 {
+    if (depth == 1) {
+        rect_internal((uint8_t *)src_buf, row_pitch, 0, 0, width, height,
+                      dst_buf, width, height, bytes_per_pixel, true);
+        return;
+    }
+
     uint32_t mask_x, mask_y, mask_z;
     generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
 
@@ -137,6 +359,12 @@ static inline void unswizzle_box_internal(
     unsigned int slice_pitch,
     unsigned int bytes_per_pixel)
 {
+    if (depth == 1) {
+        rect_internal(dst_buf, row_pitch, 0, 0, width, height,
+                      (uint8_t *)src_buf, width, height, bytes_per_pixel, false);
+        return;
+    }
+
     uint32_t mask_x, mask_y, mask_z;
     generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
 
@@ -194,3 +422,33 @@ MULTIVERSION(unswizzle_box)
 
 #undef C
 #undef MULTIVERSION
+
+/* Multiversioned like swizzle_box for the common bytes_per_pixel */
+#define C(linear, swizzled, bpp, to_swizzled)                           \
+    rect_internal(linear, pitch, x, y, width, height, swizzled, tex_width, \
+                  tex_height, bpp, to_swizzled)
+#define MULTIVERSION(m, linear, swizzled, to_swizzled)                              \
+    void m(const uint8_t *src_buf, unsigned int x, unsigned int y,                  \
+           unsigned int width, unsigned int height, uint8_t *dst_buf,               \
+           unsigned int tex_width, unsigned int tex_height, unsigned int pitch,     \
+           unsigned int bytes_per_pixel)                                            \
+    {                                                                               \
+        switch (bytes_per_pixel) {                                                  \
+        case 2:                                                                     \
+            C(linear, swizzled, 2, to_swizzled);                                    \
+            break;                                                                  \
+        case 4:                                                                     \
+            C(linear, swizzled, 4, to_swizzled);                                    \
+            break;                                                                  \
+        default:                                                                    \
+            C(linear, swizzled, bytes_per_pixel, to_swizzled);                      \
+        }                                                                           \
+    }
+
+MULTIVERSION(swizzle_subrect, (uint8_t *)src_buf, dst_buf, true)
+MULTIVERSION(unswizzle_subrect, dst_buf, (uint8_t *)src_buf, false)
+
+#undef C
+#undef MULTIVERSION
+#undef TILE_SIZE
+#undef TILE_MAX_COUNT
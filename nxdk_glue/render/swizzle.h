@@ -43,6 +43,38 @@ void unswizzle_box(
     unsigned int slice_pitch,
     unsigned int bytes_per_pixel);
 
+/*
+ * Swizzle the linear rect src_buf of width x height pixels into a swizzled texture of
+ * tex_width x tex_height at position (x, y). Only the pixels of the rect are touched.
+ */
+void swizzle_subrect(
+    const uint8_t *src_buf,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    uint8_t *dst_buf,
+    unsigned int tex_width,
+    unsigned int tex_height,
+    unsigned int pitch,
+    unsigned int bytes_per_pixel);
+
+/*
+ * Unswizzle the rect at position (x, y) of width x height pixels from a swizzled texture of
+ * tex_width x tex_height into the linear buffer dst_buf.
+ */
+void unswizzle_subrect(
+    const uint8_t *src_buf,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    uint8_t *dst_buf,
+    unsigned int tex_width,
+    unsigned int tex_height,
+    unsigned int pitch,
+    unsigned int bytes_per_pixel);
+
 static inline void unswizzle_rect(
     const uint8_t *src_buf,
     unsigned int width,
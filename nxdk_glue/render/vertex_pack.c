@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#include <string.h>
+
+#include "vertex_pack.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+static inline const float *source_element(const float *base, int stride, int index)
+{
+    return (const float *)((const char *)base + index * stride);
+}
+
+static inline bool fits_int16(float value)
+{
+    return value >= INT16_MIN && value <= INT16_MAX && value == (float)(int32_t)value;
+}
+
+bool vertex_pack_fits_compact(const vertex_pack_source_t *src)
+{
+    for (int i = 0; i < src->num_vertices; i++) {
+        const float *vertex_pos = source_element(src->xy, src->xy_stride, i);
+        if (!fits_int16(vertex_pos[0] * src->scale_x) || !fits_int16(vertex_pos[1] * src->scale_y)) {
+            return false;
+        }
+
+        if (src->uv) {
+            const float *vertex_uv = source_element(src->uv, src->uv_stride, i);
+            if (!fits_int16(vertex_uv[0] * src->u_scale + src->u_offset) ||
+                !fits_int16(vertex_uv[1] * src->v_scale + src->v_offset)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// We could keep the color as four floats but we can save alot of vertex buffer space making it uint_8_t
+static inline uint32_t pack_color(const float *color, float color_scale)
+{
+    uint32_t r = (uint32_t)(color[0] * color_scale * 255.0f);
+    uint32_t g = (uint32_t)(color[1] * color_scale * 255.0f);
+    uint32_t b = (uint32_t)(color[2] * color_scale * 255.0f);
+    uint32_t a = (uint32_t)(color[3] * 255.0f);
+
+    r = (r < UINT8_MAX) ? r : UINT8_MAX;
+    g = (g < UINT8_MAX) ? g : UINT8_MAX;
+    b = (b < UINT8_MAX) ? b : UINT8_MAX;
+    a = (a < UINT8_MAX) ? a : UINT8_MAX;
+
+    // Byte order in memory is r, g, b, a
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+void vertex_pack_scalar(const vertex_pack_source_t *src, enum vertex_format format, uint8_t *dst)
+{
+    const size_t stride = vertex_format_stride(format);
+
+    for (int i = 0; i < src->num_vertices; i++) {
+        const float *vertex_pos = source_element(src->xy, src->xy_stride, i);
+        const float *vertex_uv = (src->uv) ? source_element(src->uv, src->uv_stride, i) : NULL;
+        const uint32_t rgba = pack_color(source_element(src->color, src->color_stride, i), src->color_scale);
+
+        switch (format) {
+        case VERTEX_FORMAT_COLOR:
+        {
+            xgu_vertex_t *vertex = (xgu_vertex_t *)dst;
+            vertex->pos[0] = vertex_pos[0] * src->scale_x;
+            vertex->pos[1] = vertex_pos[1] * src->scale_y;
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            break;
+        }
+        case VERTEX_FORMAT_TEXTURED:
+        {
+            xgu_vertex_textured_t *vertex = (xgu_vertex_textured_t *)dst;
+            vertex->pos[0] = vertex_pos[0] * src->scale_x;
+            vertex->pos[1] = vertex_pos[1] * src->scale_y;
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            vertex->tex[0] = vertex_uv[0] * src->u_scale + src->u_offset;
+            vertex->tex[1] = vertex_uv[1] * src->v_scale + src->v_offset;
+            break;
+        }
+        case VERTEX_FORMAT_COLOR_COMPACT:
+        {
+            xgu_vertex_compact_t *vertex = (xgu_vertex_compact_t *)dst;
+            vertex->pos[0] = (int16_t)(vertex_pos[0] * src->scale_x);
+            vertex->pos[1] = (int16_t)(vertex_pos[1] * src->scale_y);
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            break;
+        }
+        case VERTEX_FORMAT_TEXTURED_COMPACT:
+        {
+            xgu_vertex_textured_compact_t *vertex = (xgu_vertex_textured_compact_t *)dst;
+            vertex->pos[0] = (int16_t)(vertex_pos[0] * src->scale_x);
+            vertex->pos[1] = (int16_t)(vertex_pos[1] * src->scale_y);
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            vertex->tex[0] = (int16_t)(vertex_uv[0] * src->u_scale + src->u_offset);
+            vertex->tex[1] = (int16_t)(vertex_uv[1] * src->v_scale + src->v_offset);
+            break;
+        }
+        }
+        dst += stride;
+    }
+}
+
+#ifdef __SSE__
+// Lane helpers. SSE1 has no packed float to int conversion without MMX so each lane is converted on its own.
+#define LANE(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(i, i, i, i))
+
+static inline uint32_t pack_color_sse(const float *color, __m128 color_scale)
+{
+    // Multiply by the colour scale then 255 as two steps so the rounding matches pack_color exactly
+    __m128 c = _mm_mul_ps(_mm_loadu_ps(color), color_scale);
+    c = _mm_mul_ps(c, _mm_set1_ps(255.0f));
+    c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+
+    const uint32_t r = (uint32_t)_mm_cvttss_si32(c);
+    const uint32_t g = (uint32_t)_mm_cvttss_si32(LANE(c, 1));
+    const uint32_t b = (uint32_t)_mm_cvttss_si32(LANE(c, 2));
+    const uint32_t a = (uint32_t)_mm_cvttss_si32(LANE(c, 3));
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static bool colors_uniform(const vertex_pack_source_t *src)
+{
+    const float *first = src->color;
+    for (int i = 1; i < src->num_vertices; i++) {
+        if (memcmp(first, source_element(src->color, src->color_stride, i), 4 * sizeof(float)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void vertex_pack_sse(const vertex_pack_source_t *src, enum vertex_format format, uint8_t *dst)
+{
+    const size_t stride = vertex_format_stride(format);
+    const bool textured = (format == VERTEX_FORMAT_TEXTURED || format == VERTEX_FORMAT_TEXTURED_COMPACT);
+
+    // Position and texture coordinates share one register as { x, y, u, v }
+    const __m128 scale = _mm_set_ps(src->v_scale, src->u_scale, src->scale_y, src->scale_x);
+    const __m128 offset = _mm_set_ps(src->v_offset, src->u_offset, 0.0f, 0.0f);
+    const __m128 color_scale = _mm_set_ps(1.0f, src->color_scale, src->color_scale, src->color_scale);
+
+    // Most geometry (sprites, text, rects) has the same colour on every vertex, so only convert it once
+    const bool uniform_color = (src->num_vertices > 0) && colors_uniform(src);
+    uint32_t rgba = (uniform_color) ? pack_color_sse(src->color, color_scale) : 0;
+
+    for (int i = 0; i < src->num_vertices; i++) {
+        __m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)source_element(src->xy, src->xy_stride, i));
+        if (textured) {
+            v = _mm_loadh_pi(v, (const __m64 *)source_element(src->uv, src->uv_stride, i));
+        }
+        v = _mm_add_ps(_mm_mul_ps(v, scale), offset);
+
+        if (!uniform_color) {
+            rgba = pack_color_sse(source_element(src->color, src->color_stride, i), color_scale);
+        }
+
+        switch (format) {
+        case VERTEX_FORMAT_COLOR:
+        {
+            xgu_vertex_t *vertex = (xgu_vertex_t *)dst;
+            _mm_storel_pi((__m64 *)vertex->pos, v);
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            break;
+        }
+        case VERTEX_FORMAT_TEXTURED:
+        {
+            xgu_vertex_textured_t *vertex = (xgu_vertex_textured_t *)dst;
+            _mm_storel_pi((__m64 *)vertex->pos, v);
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            _mm_storeh_pi((__m64 *)vertex->tex, v);
+            break;
+        }
+        case VERTEX_FORMAT_COLOR_COMPACT:
+        {
+            xgu_vertex_compact_t *vertex = (xgu_vertex_compact_t *)dst;
+            vertex->pos[0] = (int16_t)_mm_cvttss_si32(v);
+            vertex->pos[1] = (int16_t)_mm_cvttss_si32(LANE(v, 1));
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            break;
+        }
+        case VERTEX_FORMAT_TEXTURED_COMPACT:
+        {
+            xgu_vertex_textured_compact_t *vertex = (xgu_vertex_textured_compact_t *)dst;
+            vertex->pos[0] = (int16_t)_mm_cvttss_si32(v);
+            vertex->pos[1] = (int16_t)_mm_cvttss_si32(LANE(v, 1));
+            memcpy(vertex->color, &rgba, sizeof(rgba));
+            vertex->tex[0] = (int16_t)_mm_cvttss_si32(LANE(v, 2));
+            vertex->tex[1] = (int16_t)_mm_cvttss_si32(LANE(v, 3));
+            break;
+        }
+        }
+        dst += stride;
+    }
+}
+
+#undef LANE
+#endif
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#ifndef VERTEX_PACK_H
+#define VERTEX_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Vertex layouts written into the XGU vertex arena. This file has no nxdk or SDL dependencies so that
+// the packing kernels can be built and compared against each other on a host machine.
+
+typedef struct xgu_vertex
+{
+    float pos[2];     // xy
+    uint8_t color[4]; // rgba8888
+} xgu_vertex_t;
+
+typedef struct xgu_vertex_texture
+{
+    float pos[2];     // xy
+    uint8_t color[4]; // rgba8888
+    float tex[2];     // uv
+} xgu_vertex_textured_t;
+
+typedef struct xgu_vertex_compact
+{
+    int16_t pos[2];   // xy
+    uint8_t color[4]; // rgba8888
+} xgu_vertex_compact_t;
+
+typedef struct xgu_vertex_textured_compact
+{
+    int16_t pos[2];   // xy
+    uint8_t color[4]; // rgba8888
+    int16_t tex[2];   // uv
+} xgu_vertex_textured_compact_t;
+
+enum vertex_format
+{
+    VERTEX_FORMAT_COLOR,
+    VERTEX_FORMAT_TEXTURED,
+    VERTEX_FORMAT_COLOR_COMPACT,
+    VERTEX_FORMAT_TEXTURED_COMPACT,
+};
+
+// The source vertex streams as SDL provides them to QueueGeometry. Colours are four floats (SDL_FColor).
+// uv may be NULL for untextured geometry. Texture coordinates are written as uv * scale + offset.
+typedef struct vertex_pack_source
+{
+    const float *xy;
+    int xy_stride;
+    const float *color;
+    int color_stride;
+    const float *uv;
+    int uv_stride;
+    int num_vertices;
+    float scale_x;
+    float scale_y;
+    float u_scale;
+    float v_scale;
+    float u_offset;
+    float v_offset;
+    float color_scale;
+} vertex_pack_source_t;
+
+static inline size_t vertex_format_stride(enum vertex_format format)
+{
+    switch (format) {
+    case VERTEX_FORMAT_TEXTURED:
+        return sizeof(xgu_vertex_textured_t);
+    case VERTEX_FORMAT_COLOR_COMPACT:
+        return sizeof(xgu_vertex_compact_t);
+    case VERTEX_FORMAT_TEXTURED_COMPACT:
+        return sizeof(xgu_vertex_textured_compact_t);
+    case VERTEX_FORMAT_COLOR:
+    default:
+        return sizeof(xgu_vertex_t);
+    }
+}
+
+// Returns true if every position and texture coordinate is a whole number that fits in an int16_t
+bool vertex_pack_fits_compact(const vertex_pack_source_t *src);
+
+// Reference implementation. Converts src into num_vertices vertices of the given format at dst.
+void vertex_pack_scalar(const vertex_pack_source_t *src, enum vertex_format format, uint8_t *dst);
+
+#ifdef __SSE__
+// SSE1 implementation, produces the same output as vertex_pack_scalar.
+void vertex_pack_sse(const vertex_pack_source_t *src, enum vertex_format format, uint8_t *dst);
+#endif
+
+static inline void vertex_pack(const vertex_pack_source_t *src, enum vertex_format format, uint8_t *dst)
+{
+#ifdef __SSE__
+    vertex_pack_sse(src, format, dst);
+#else
+    vertex_pack_scalar(src, format, dst);
+#endif
+}
+
+#endif
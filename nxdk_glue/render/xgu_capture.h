@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+#ifndef XGU_CAPTURE_H
+#define XGU_CAPTURE_H
+
+#include <stdint.h>
+
+// File format written by SDL_XGU_CapturePushbuffer and read by tools/xgu_capture_analyze.c. This file has no
+// nxdk or SDL dependencies so that the analyzer can be built on a host machine.
+//
+// The file starts with an xgu_capture_header_t followed by records until the end of the file. Each record is an
+// xgu_capture_record_t followed by dword_count little endian pushbuffer dwords, exactly as they were written
+// between pb_begin and pb_end. A pb_begin/pb_end segment that holds several render commands is split into one
+// record per command, the last record of each segment has XGU_CAPTURE_FLAG_SEGMENT_END set.
+
+#define XGU_CAPTURE_MAGIC   0x43425058 // "XPBC"
+#define XGU_CAPTURE_VERSION 1
+
+#define XGU_CAPTURE_FLAG_SEGMENT_END 0x0001
+
+typedef struct xgu_capture_header
+{
+    uint32_t magic;
+    uint32_t version;
+} xgu_capture_header_t;
+
+typedef struct xgu_capture_record
+{
+    uint32_t frame; // Counted from 0 at the start of the capture
+    uint16_t tag;   // enum xgu_capture_tag of the code that pushed the dwords
+    uint16_t flags;
+    uint32_t dword_count;
+} xgu_capture_record_t;
+
+enum xgu_capture_tag
+{
+    XGU_CAPTURE_TAG_OTHER, // Renderer setup, texture and render target changes
+    XGU_CAPTURE_TAG_SET_VIEWPORT,
+    XGU_CAPTURE_TAG_SET_CLIP_RECT,
+    XGU_CAPTURE_TAG_SET_DRAW_COLOR,
+    XGU_CAPTURE_TAG_CLEAR,
+    XGU_CAPTURE_TAG_DRAW_POINTS,
+    XGU_CAPTURE_TAG_DRAW_LINES,
+    XGU_CAPTURE_TAG_GEOMETRY,
+    XGU_CAPTURE_TAG_BUNDLE,
+    XGU_CAPTURE_TAG_PRESENT,
+    XGU_CAPTURE_TAG_COUNT
+};
+
+static inline const char *xgu_capture_tag_name(uint16_t tag)
+{
+    static const char *const names[XGU_CAPTURE_TAG_COUNT] = {
+        "other", "set_viewport", "set_clip_rect", "set_draw_color", "clear",
+        "draw_points", "draw_lines", "geometry", "bundle", "present",
+    };
+    return (tag < XGU_CAPTURE_TAG_COUNT) ? names[tag] : "unknown";
+}
+
+#endif
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// The parts of SDL that the glue under test uses, so host tests don't need SDL built
+
+#ifndef TESTS_STUB_SDL_H
+#define TESTS_STUB_SDL_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SDL_malloc  malloc
+#define SDL_calloc  calloc
+#define SDL_realloc realloc
+#define SDL_free    free
+#define SDL_assert  assert
+
+// Tests are single threaded
+typedef int SDL_SpinLock;
+#define SDL_LockSpinlock(lock)   ((void)(lock))
+#define SDL_UnlockSpinlock(lock) ((void)(lock))
+
+#endif
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Kernel declarations used by the glue under test. Each test provides the functions, usually as mocks that
+// record their calls.
+
+#ifndef TESTS_STUB_XBOXKRNL_H
+#define TESTS_STUB_XBOXKRNL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned long ULONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef void *PVOID;
+
+#define PAGE_SIZE         4096
+#define PAGE_READWRITE    0x04
+#define PAGE_WRITECOMBINE 0x400
+
+PVOID MmAllocateContiguousMemoryEx(SIZE_T NumberOfBytes, ULONG_PTR LowestAcceptableAddress,
+                                   ULONG_PTR HighestAcceptableAddress, ULONG_PTR Alignment, ULONG ProtectionType);
+void MmFreeContiguousMemory(PVOID BaseAddress);
+
+#endif
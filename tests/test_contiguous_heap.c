@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Tests the contiguous heap against a mocked kernel that hands out page aligned host memory and records every
+// allocation, so block splitting and merging, returning empty blocks, direct allocations and the statistics can
+// be checked off the Xbox.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xboxkrnl/xboxkrnl.h>
+
+#include "contiguous_heap.h"
+
+// Mirrors the heap's configuration
+#define BLOCK_SIZE       (256 * 1024)
+#define MIN_CHUNK        128
+#define DIRECT_THRESHOLD (64 * 1024)
+
+// Mocked kernel
+
+#define MAX_KERNEL_ALLOCATIONS 64
+
+typedef struct kernel_allocation
+{
+    void *ptr;
+    size_t size;
+    ULONG protect;
+} kernel_allocation_t;
+
+static kernel_allocation_t kernel_allocations[MAX_KERNEL_ALLOCATIONS];
+static int kernel_allocation_count;
+static int kernel_alloc_calls;
+static int kernel_free_calls;
+static bool kernel_fail;
+
+PVOID MmAllocateContiguousMemoryEx(SIZE_T NumberOfBytes, ULONG_PTR LowestAcceptableAddress,
+                                   ULONG_PTR HighestAcceptableAddress, ULONG_PTR Alignment, ULONG ProtectionType)
+{
+    (void)LowestAcceptableAddress;
+    (void)HighestAcceptableAddress;
+    (void)Alignment;
+
+    kernel_alloc_calls++;
+    if (kernel_fail || kernel_allocation_count == MAX_KERNEL_ALLOCATIONS) {
+        return NULL;
+    }
+
+    const size_t size = (NumberOfBytes + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    void *ptr = aligned_alloc(PAGE_SIZE, size);
+    kernel_allocations[kernel_allocation_count++] = (kernel_allocation_t){ ptr, size, ProtectionType };
+    return ptr;
+}
+
+void MmFreeContiguousMemory(PVOID BaseAddress)
+{
+    kernel_free_calls++;
+    for (int i = 0; i < kernel_allocation_count; i++) {
+        if (kernel_allocations[i].ptr == BaseAddress) {
+            free(BaseAddress);
+            kernel_allocations[i] = kernel_allocations[--kernel_allocation_count];
+            return;
+        }
+    }
+    fprintf(stderr, "MmFreeContiguousMemory called with unknown pointer %p\n", BaseAddress);
+    abort();
+}
+
+static const kernel_allocation_t *kernel_find(const void *ptr)
+{
+    for (int i = 0; i < kernel_allocation_count; i++) {
+        const uint8_t *base = kernel_allocations[i].ptr;
+        if ((const uint8_t *)ptr >= base && (const uint8_t *)ptr < base + kernel_allocations[i].size) {
+            return &kernel_allocations[i];
+        }
+    }
+    return NULL;
+}
+
+// Test helpers
+
+static int failures;
+static const char *current_test;
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            printf("FAIL %s:%d in %s: %s\n", __FILE__, __LINE__, current_test, #condition); \
+            failures++;                                                                    \
+        }                                                                                  \
+    } while (0)
+
+static contiguous_heap_stats_t stats(contiguous_heap_pool_t pool)
+{
+    contiguous_heap_stats_t result;
+    contiguous_heap_get_stats(pool, &result);
+    return result;
+}
+
+// Every test must leave both pools empty, which also checks that all blocks were given back
+static void check_empty(void)
+{
+    for (int pool = 0; pool < CONTIGUOUS_HEAP_POOL_COUNT; pool++) {
+        const contiguous_heap_stats_t s = stats((contiguous_heap_pool_t)pool);
+        CHECK(s.bytes_in_use == 0);
+        CHECK(s.bytes_reserved == 0);
+    }
+    CHECK(kernel_allocation_count == 0);
+}
+
+static void begin(const char *name)
+{
+    current_test = name;
+    kernel_alloc_calls = 0;
+    kernel_free_calls = 0;
+    kernel_fail = false;
+}
+
+// Tests
+
+static void test_rounding_and_alignment(void)
+{
+    begin("rounding and alignment");
+
+    CHECK(contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 0) == NULL);
+
+    const size_t sizes[] = { 1, 127, 128, 129, 1000, 4096, 4097, DIRECT_THRESHOLD };
+    const size_t rounded[] = { 128, 128, 128, 256, 1024, 4096, 8192, DIRECT_THRESHOLD };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint8_t *ptr = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, sizes[i]);
+        CHECK(ptr != NULL);
+        CHECK(((uintptr_t)ptr % MIN_CHUNK) == 0);
+        CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == rounded[i]);
+        // The whole allocation must be usable memory from a kernel allocation
+        const kernel_allocation_t *allocation = kernel_find(ptr);
+        CHECK(allocation != NULL && ptr + sizes[i] <= (uint8_t *)allocation->ptr + allocation->size);
+        memset(ptr, 0xAB, sizes[i]);
+        contiguous_heap_free(ptr);
+    }
+
+    contiguous_heap_free(NULL);
+    check_empty();
+}
+
+static void test_split_and_merge(void)
+{
+    begin("split and merge");
+
+    // The first allocation splits a fresh block all the way down, its buddies follow it
+    uint8_t *a = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK);
+    uint8_t *b = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK);
+    uint8_t *c = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 2 * MIN_CHUNK);
+    uint8_t *d = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 4 * MIN_CHUNK);
+    CHECK(kernel_alloc_calls == 1);
+    CHECK(b == a + MIN_CHUNK);
+    CHECK(c == a + 2 * MIN_CHUNK);
+    CHECK(d == a + 4 * MIN_CHUNK);
+
+    // A freed chunk is reused by the next allocation of its size
+    contiguous_heap_free(b);
+    CHECK(contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK) == b);
+
+    // Freeing a and b merges them back into a 256 byte chunk, which a 256 byte allocation then gets
+    contiguous_heap_free(a);
+    contiguous_heap_free(b);
+    uint8_t *merged = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 2 * MIN_CHUNK);
+    CHECK(merged == a);
+
+    // While c is in use the merged chunk can't grow past 256 bytes, so a 512 byte allocation goes after d
+    contiguous_heap_free(merged);
+    uint8_t *e = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 4 * MIN_CHUNK);
+    CHECK(e == a + 8 * MIN_CHUNK);
+    contiguous_heap_free(e);
+
+    // Freeing c merges it with its buddy into the 512 byte chunk at a
+    contiguous_heap_free(c);
+    uint8_t *quad = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 4 * MIN_CHUNK);
+    CHECK(quad == a);
+
+    contiguous_heap_free(quad);
+    contiguous_heap_free(d);
+    check_empty();
+}
+
+static void test_full_block_merges(void)
+{
+    begin("full block merges");
+
+    // Keep one quarter of a block allocated so it isn't given back, then fill the rest with small chunks
+    uint8_t *keep = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, BLOCK_SIZE / 4);
+    CHECK(keep != NULL);
+
+    enum { SMALL_COUNT = (BLOCK_SIZE - BLOCK_SIZE / 4) / MIN_CHUNK };
+    static uint8_t *small[SMALL_COUNT];
+    for (int i = 0; i < SMALL_COUNT; i++) {
+        small[i] = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK);
+        CHECK(small[i] != NULL && kernel_find(small[i]) == kernel_find(keep));
+    }
+    CHECK(kernel_alloc_calls == 1);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == BLOCK_SIZE);
+
+    // The block is full, so the next allocation needs a new one
+    uint8_t *overflow = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK);
+    CHECK(overflow != NULL && kernel_find(overflow) != kernel_find(keep));
+    CHECK(kernel_alloc_calls == 2);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_reserved == 2 * BLOCK_SIZE);
+
+    // The second block is given back as soon as it's empty
+    contiguous_heap_free(overflow);
+    CHECK(kernel_free_calls == 1);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_reserved == BLOCK_SIZE);
+
+    // Free the small chunks in an interleaved order, they must merge back into three whole quarters
+    for (int i = 0; i < SMALL_COUNT; i += 2) {
+        contiguous_heap_free(small[i]);
+    }
+    for (int i = 1; i < SMALL_COUNT; i += 2) {
+        contiguous_heap_free(small[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        small[i] = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, BLOCK_SIZE / 4);
+        CHECK(small[i] != NULL && kernel_find(small[i]) == kernel_find(keep));
+    }
+    CHECK(kernel_alloc_calls == 2);
+
+    for (int i = 0; i < 3; i++) {
+        contiguous_heap_free(small[i]);
+    }
+    contiguous_heap_free(keep);
+    CHECK(kernel_free_calls == 2);
+    check_empty();
+}
+
+static void test_empty_block_returned(void)
+{
+    begin("empty block returned");
+
+    uint8_t *ptr = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 1000);
+    CHECK(kernel_alloc_calls == 1);
+    CHECK(kernel_allocation_count == 1 && kernel_allocations[0].size == BLOCK_SIZE);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_reserved == BLOCK_SIZE);
+
+    contiguous_heap_free(ptr);
+    CHECK(kernel_free_calls == 1);
+    check_empty();
+
+    // The next allocation gets a new block from the kernel
+    ptr = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 1000);
+    CHECK(ptr != NULL && kernel_alloc_calls == 2);
+    contiguous_heap_free(ptr);
+    check_empty();
+}
+
+static void test_direct_allocations(void)
+{
+    begin("direct allocations");
+
+    // Allocations above the threshold go straight to the kernel, rounded to pages
+    const size_t size = DIRECT_THRESHOLD + 1;
+    const size_t page_rounded = (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    uint8_t *direct = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, size);
+    CHECK(direct != NULL && kernel_alloc_calls == 1);
+    CHECK(kernel_find(direct) != NULL && kernel_find(direct)->ptr == direct);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == page_rounded);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_reserved == page_rounded);
+
+    // Larger than a block works too
+    uint8_t *large = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 3 * BLOCK_SIZE);
+    CHECK(large != NULL && kernel_alloc_calls == 2);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == page_rounded + 3 * BLOCK_SIZE);
+    memset(large, 0, 3 * BLOCK_SIZE);
+
+    // A sub-allocation alongside them still comes from a block
+    uint8_t *small = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 64);
+    CHECK(kernel_alloc_calls == 3 && kernel_find(small)->size == BLOCK_SIZE);
+
+    contiguous_heap_free(direct);
+    CHECK(kernel_free_calls == 1);
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == 3 * BLOCK_SIZE + MIN_CHUNK);
+    contiguous_heap_free(large);
+    contiguous_heap_free(small);
+    check_empty();
+}
+
+static void test_pools(void)
+{
+    begin("pools");
+
+    uint8_t *write_combined = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 256);
+    uint8_t *cached = contiguous_heap_alloc(CONTIGUOUS_HEAP_CACHED, 512);
+    uint8_t *cached_direct = contiguous_heap_alloc(CONTIGUOUS_HEAP_CACHED, 2 * DIRECT_THRESHOLD);
+
+    // Each pool has its own blocks, allocated with its own protection
+    CHECK(kernel_find(write_combined) != kernel_find(cached));
+    CHECK(kernel_find(write_combined)->protect == (PAGE_READWRITE | PAGE_WRITECOMBINE));
+    CHECK(kernel_find(cached)->protect == PAGE_READWRITE);
+    CHECK(kernel_find(cached_direct)->protect == PAGE_READWRITE);
+
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == 256);
+    CHECK(stats(CONTIGUOUS_HEAP_CACHED).bytes_in_use == 512 + 2 * DIRECT_THRESHOLD);
+
+    // Freeing doesn't need to know the pool
+    contiguous_heap_free(cached);
+    contiguous_heap_free(write_combined);
+    contiguous_heap_free(cached_direct);
+    check_empty();
+}
+
+static void test_kernel_failure(void)
+{
+    begin("kernel failure");
+
+    kernel_fail = true;
+    CHECK(contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 100) == NULL);
+    CHECK(contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 2 * DIRECT_THRESHOLD) == NULL);
+    CHECK(kernel_alloc_calls == 2);
+    check_empty();
+
+    // Once a block exists, allocations that fit in it don't need the kernel
+    kernel_fail = false;
+    uint8_t *first = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 100);
+    kernel_fail = true;
+    uint8_t *second = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, 100);
+    CHECK(second != NULL && kernel_find(second) == kernel_find(first));
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).bytes_in_use == 2 * MIN_CHUNK);
+    kernel_fail = false;
+
+    contiguous_heap_free(first);
+    contiguous_heap_free(second);
+    check_empty();
+}
+
+// Percentage of free block memory outside the largest free chunk, as contiguous_heap_get_stats works it out
+static unsigned int fragmentation(size_t free_bytes, size_t largest_free)
+{
+    return (unsigned int)(100 - (largest_free * 100) / free_bytes);
+}
+
+static void test_stats(void)
+{
+    begin("stats");
+
+    const size_t peak_before = stats(CONTIGUOUS_HEAP_WRITECOMBINE).peak_bytes_in_use;
+    CHECK(stats(CONTIGUOUS_HEAP_WRITECOMBINE).fragmentation == 0);
+
+    // One chunk at the start of a block leaves free chunks of 128 bytes, 256 bytes, ... up to half the block
+    uint8_t *first = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, MIN_CHUNK);
+    contiguous_heap_stats_t s = stats(CONTIGUOUS_HEAP_WRITECOMBINE);
+    CHECK(s.bytes_in_use == MIN_CHUNK);
+    CHECK(s.bytes_reserved == BLOCK_SIZE);
+    CHECK(s.fragmentation == fragmentation(BLOCK_SIZE - MIN_CHUNK, BLOCK_SIZE / 2));
+
+    // A quarter of the block comes out of the first half, the second half is still the largest free chunk
+    uint8_t *quarter = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, BLOCK_SIZE / 4);
+    s = stats(CONTIGUOUS_HEAP_WRITECOMBINE);
+    CHECK(s.bytes_in_use == MIN_CHUNK + BLOCK_SIZE / 4);
+    CHECK(s.fragmentation == fragmentation(BLOCK_SIZE * 3 / 4 - MIN_CHUNK, BLOCK_SIZE / 2));
+
+    // Direct allocations count towards in use and reserved but not fragmentation
+    uint8_t *direct = contiguous_heap_alloc(CONTIGUOUS_HEAP_WRITECOMBINE, BLOCK_SIZE);
+    s = stats(CONTIGUOUS_HEAP_WRITECOMBINE);
+    CHECK(s.bytes_in_use == MIN_CHUNK + BLOCK_SIZE / 4 + BLOCK_SIZE);
+    CHECK(s.bytes_reserved == 2 * BLOCK_SIZE);
+    CHECK(s.fragmentation == fragmentation(BLOCK_SIZE * 3 / 4 - MIN_CHUNK, BLOCK_SIZE / 2));
+    const size_t peak = (s.bytes_in_use > peak_before) ? s.bytes_in_use : peak_before;
+    CHECK(s.peak_bytes_in_use == peak);
+
+    // Freeing keeps the peak, and the quarter merges back into the first half
+    contiguous_heap_free(direct);
+    contiguous_heap_free(quarter);
+    s = stats(CONTIGUOUS_HEAP_WRITECOMBINE);
+    CHECK(s.bytes_in_use == MIN_CHUNK);
+    CHECK(s.bytes_reserved == BLOCK_SIZE);
+    CHECK(s.peak_bytes_in_use == peak);
+    CHECK(s.fragmentation == fragmentation(BLOCK_SIZE - MIN_CHUNK, BLOCK_SIZE / 2));
+
+    // Without blocks there is nothing to fragment
+    contiguous_heap_free(first);
+    s = stats(CONTIGUOUS_HEAP_WRITECOMBINE);
+    CHECK(s.fragmentation == 0);
+    CHECK(s.peak_bytes_in_use == peak);
+    check_empty();
+}
+
+int main(void)
+{
+    test_rounding_and_alignment();
+    test_split_and_merge();
+    test_full_block_merges();
+    test_empty_block_returned();
+    test_direct_allocations();
+    test_pools();
+    test_kernel_failure();
+    test_stats();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All contiguous heap tests passed\n");
+    return EXIT_SUCCESS;
+}
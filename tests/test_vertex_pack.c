@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Packs random geometry with vertex_pack_sse and vertex_pack_scalar and checks that the output is identical
+// for every vertex format, with per-vertex colours and with one colour for the whole draw.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vertex_pack.h"
+
+#ifndef __SSE__
+#error "The vertex packing test needs a host compiler with SSE enabled"
+#endif
+
+#define MAX_VERTICES 1024
+#define ITERATIONS   500
+
+// Source vertices are interleaved like SDL_Vertex: xy, then colour, then uv
+typedef struct source_vertex
+{
+    float xy[2];
+    float color[4];
+    float uv[2];
+} source_vertex_t;
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float rng_float(float min, float max)
+{
+    return min + (max - min) * (float)(rng_next() & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static int rng_int(int min, int max)
+{
+    return min + (int)(rng_next() % (uint32_t)(max - min + 1));
+}
+
+static const char *format_name(enum vertex_format format)
+{
+    switch (format) {
+    case VERTEX_FORMAT_COLOR:
+        return "COLOR";
+    case VERTEX_FORMAT_TEXTURED:
+        return "TEXTURED";
+    case VERTEX_FORMAT_COLOR_COMPACT:
+        return "COLOR_COMPACT";
+    case VERTEX_FORMAT_TEXTURED_COMPACT:
+        return "TEXTURED_COMPACT";
+    }
+    return "?";
+}
+
+// Fills the vertices and the source description. Compact formats get whole numbers that fit an int16_t once
+// scaled, the way the renderer only picks them when vertex_pack_fits_compact passes.
+static void generate(source_vertex_t *vertices, int count, enum vertex_format format, bool uniform_color,
+                     vertex_pack_source_t *src)
+{
+    const bool compact = (format == VERTEX_FORMAT_COLOR_COMPACT || format == VERTEX_FORMAT_TEXTURED_COMPACT);
+    const bool textured = (format == VERTEX_FORMAT_TEXTURED || format == VERTEX_FORMAT_TEXTURED_COMPACT);
+
+    memset(src, 0, sizeof(*src));
+    src->num_vertices = count;
+    src->scale_x = (compact) ? 1.0f : rng_float(0.5f, 2.0f);
+    src->scale_y = (compact) ? 1.0f : rng_float(0.5f, 2.0f);
+    src->u_scale = (compact) ? (float)rng_int(1, 256) : rng_float(0.0f, 1.0f);
+    src->v_scale = (compact) ? (float)rng_int(1, 256) : rng_float(0.0f, 1.0f);
+    src->u_offset = (compact) ? (float)rng_int(-64, 64) : rng_float(-1.0f, 1.0f);
+    src->v_offset = (compact) ? (float)rng_int(-64, 64) : rng_float(-1.0f, 1.0f);
+    // Colour scales above 1 make the clamp to 255 matter
+    src->color_scale = rng_float(0.25f, 4.0f);
+
+    float color[4];
+    for (int c = 0; c < 4; c++) {
+        color[c] = rng_float(0.0f, 1.0f);
+    }
+
+    for (int i = 0; i < count; i++) {
+        source_vertex_t *vertex = &vertices[i];
+        if (compact) {
+            vertex->xy[0] = (float)rng_int(-4096, 4096);
+            vertex->xy[1] = (float)rng_int(-4096, 4096);
+            vertex->uv[0] = (float)rng_int(0, 64);
+            vertex->uv[1] = (float)rng_int(0, 64);
+        } else {
+            vertex->xy[0] = rng_float(-1000.0f, 1000.0f);
+            vertex->xy[1] = rng_float(-1000.0f, 1000.0f);
+            vertex->uv[0] = rng_float(-2.0f, 2.0f);
+            vertex->uv[1] = rng_float(-2.0f, 2.0f);
+        }
+        for (int c = 0; c < 4; c++) {
+            vertex->color[c] = (uniform_color) ? color[c] : rng_float(0.0f, 1.0f);
+        }
+    }
+
+    src->xy = vertices[0].xy;
+    src->xy_stride = sizeof(source_vertex_t);
+    src->color = vertices[0].color;
+    src->color_stride = sizeof(source_vertex_t);
+    src->uv = (textured) ? vertices[0].uv : NULL;
+    src->uv_stride = sizeof(source_vertex_t);
+}
+
+static bool compare(const vertex_pack_source_t *src, enum vertex_format format, const char *description)
+{
+    static uint8_t expected[MAX_VERTICES * sizeof(xgu_vertex_textured_t)];
+    static uint8_t actual[MAX_VERTICES * sizeof(xgu_vertex_textured_t)];
+    const size_t stride = vertex_format_stride(format);
+    const size_t size = src->num_vertices * stride;
+
+    memset(expected, 0xAA, sizeof(expected));
+    memset(actual, 0xAA, sizeof(actual));
+    vertex_pack_scalar(src, format, expected);
+    vertex_pack_sse(src, format, actual);
+
+    // Bytes past the last vertex must be left alone too
+    if (memcmp(expected, actual, size + stride) == 0) {
+        return true;
+    }
+    for (size_t offset = 0; offset < size + stride; offset++) {
+        if (expected[offset] != actual[offset]) {
+            printf("FAIL %s %s: %d vertices, first difference in vertex %zu byte %zu (%02x != %02x)\n",
+                   format_name(format), description, src->num_vertices, offset / stride, offset % stride,
+                   expected[offset], actual[offset]);
+            break;
+        }
+    }
+    return false;
+}
+
+int main(void)
+{
+    static source_vertex_t vertices[MAX_VERTICES];
+    const enum vertex_format formats[] = {
+        VERTEX_FORMAT_COLOR,
+        VERTEX_FORMAT_TEXTURED,
+        VERTEX_FORMAT_COLOR_COMPACT,
+        VERTEX_FORMAT_TEXTURED_COMPACT,
+    };
+    int failures = 0;
+    int checks = 0;
+
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        const enum vertex_format format = formats[f];
+        for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+            // Small draws are the common case, include empty and single vertex ones
+            const int count = (iteration < 8) ? iteration : rng_int(1, MAX_VERTICES);
+            vertex_pack_source_t src;
+
+            generate(vertices, count, format, false, &src);
+            if (count > 0 && !vertex_pack_fits_compact(&src) && format >= VERTEX_FORMAT_COLOR_COMPACT) {
+                printf("FAIL %s: generated vertices don't fit the compact format\n", format_name(format));
+                failures++;
+            }
+            failures += !compare(&src, format, "per-vertex colour");
+
+            generate(vertices, count, format, true, &src);
+            failures += !compare(&src, format, "uniform colour");
+
+            // A colour stride of 0 reads the same colour for every vertex
+            src.color_stride = 0;
+            failures += !compare(&src, format, "uniform colour, stride 0");
+            checks += 3;
+        }
+    }
+
+    printf("%d of %d comparisons passed\n", checks - failures, checks);
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Host implementations of the pbkit, kernel and video functions the renderer calls. Pushbuffer segments are
+// written to a host buffer and decoded in pb_end, which records the methods and writes semaphore releases
+// to memory so the renderer sees every frame finish as soon as it is pushed. Nothing is drawn.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hal/video.h>
+#include <pbkit/pbkit.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#include "fake_xbox.h"
+
+#define BACK_BUFFER_WIDTH  640
+#define BACK_BUFFER_HEIGHT 480
+
+// The renderer never has more than a few hundred dwords open, this catches a segment that was never closed
+#define SEGMENT_DWORDS (64 * 1024)
+
+#define METHOD_MASK           0x1FFC
+#define METHOD_COUNT_SHIFT    18
+#define METHOD_COUNT_MASK     0x7FF
+#define METHOD_NON_INCREASING 0x40000000
+
+#define DMA_CHANNEL_COUNT 32
+
+// NV097_CLEAR_SURFACE flags for the depth and stencil buffers and for all four color channels
+#define CLEAR_SURFACE_ZETA  0x03
+#define CLEAR_SURFACE_COLOR 0xF0
+
+static uint32_t segment[SEGMENT_DWORDS];
+static bool segment_open;
+static fake_pb_stats_t stats;
+
+static DWORD back_buffer[BACK_BUFFER_WIDTH * BACK_BUFFER_HEIGHT];
+static DWORD vbl_counter;
+
+static const void *dma_addresses[DMA_CHANNEL_COUNT];
+static uint32_t semaphore_channel;
+static uint32_t semaphore_offset;
+
+const fake_pb_stats_t *fake_pb_get_stats(void)
+{
+    return &stats;
+}
+
+void fake_pb_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+// Kernel
+
+PVOID MmAllocateContiguousMemory(SIZE_T NumberOfBytes)
+{
+    return MmAllocateContiguousMemoryEx(NumberOfBytes, 0, MAXRAM, 0, PAGE_READWRITE);
+}
+
+PVOID MmAllocateContiguousMemoryEx(SIZE_T NumberOfBytes, ULONG_PTR LowestAcceptableAddress,
+                                   ULONG_PTR HighestAcceptableAddress, ULONG_PTR Alignment, ULONG ProtectionType)
+{
+    (void)LowestAcceptableAddress;
+    (void)HighestAcceptableAddress;
+    (void)ProtectionType;
+
+    const size_t alignment = (Alignment > PAGE_SIZE) ? Alignment : PAGE_SIZE;
+    const size_t size = (NumberOfBytes + alignment - 1) & ~(alignment - 1);
+    return aligned_alloc(alignment, size);
+}
+
+void MmFreeContiguousMemory(PVOID BaseAddress)
+{
+    free(BaseAddress);
+}
+
+// Only ever pushed to the fake GPU, which ignores addresses other than the semaphore's
+ULONG_PTR MmGetPhysicalAddress(PVOID BaseAddress)
+{
+    return (ULONG_PTR)BaseAddress;
+}
+
+ULONG DbgPrint(const char *Format, ...)
+{
+    va_list args;
+    va_start(args, Format);
+    vfprintf(stderr, Format, args);
+    va_end(args);
+    return 0;
+}
+
+void Sleep(DWORD dwMilliseconds)
+{
+    if (dwMilliseconds > 0) {
+        const struct timespec ts = { dwMilliseconds / 1000, (long)(dwMilliseconds % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Video
+
+VIDEO_MODE XVideoGetMode(void)
+{
+    return (VIDEO_MODE){ BACK_BUFFER_WIDTH, BACK_BUFFER_HEIGHT, 32, 60 };
+}
+
+void XVideoFlushFB(void)
+{
+}
+
+void XVideoSetVideoEnable(bool enable)
+{
+    (void)enable;
+}
+
+// pbkit
+
+static void execute_method(uint32_t method, uint32_t parameter)
+{
+    switch (method) {
+    case NV097_SET_CONTEXT_DMA_SEMAPHORE:
+        semaphore_channel = parameter;
+        break;
+    case NV097_SET_SEMAPHORE_OFFSET:
+        semaphore_offset = parameter;
+        break;
+    case NV097_BACK_END_WRITE_SEMAPHORE_RELEASE:
+    case NV097_TEXTURE_READ_SEMAPHORE_RELEASE:
+        if (semaphore_channel < DMA_CHANNEL_COUNT && dma_addresses[semaphore_channel]) {
+            uint8_t *semaphore = (uint8_t *)dma_addresses[semaphore_channel] + semaphore_offset;
+            memcpy(semaphore, &parameter, sizeof(parameter));
+        }
+        break;
+    }
+}
+
+static uint32_t *push_method(uint32_t *p, DWORD command, DWORD nparam)
+{
+    *p++ = (nparam << METHOD_COUNT_SHIFT) | command;
+    return p;
+}
+
+int pb_init(void)
+{
+    segment_open = false;
+    memset(dma_addresses, 0, sizeof(dma_addresses));
+    return 0;
+}
+
+void pb_kill(void)
+{
+}
+
+void pb_reset(void)
+{
+}
+
+uint32_t *pb_begin(void)
+{
+    if (segment_open) {
+        fprintf(stderr, "pb_begin called with a segment already open\n");
+        abort();
+    }
+    segment_open = true;
+    return segment;
+}
+
+void pb_end(uint32_t *pEnd)
+{
+    if (!segment_open || pEnd < segment || pEnd > segment + SEGMENT_DWORDS) {
+        fprintf(stderr, "pb_end called without a matching pb_begin\n");
+        abort();
+    }
+    segment_open = false;
+
+    stats.segments++;
+    stats.bytes += (uint64_t)(pEnd - segment) * sizeof(uint32_t);
+
+    const uint32_t *p = segment;
+    while (p < pEnd) {
+        const uint32_t header = *p++;
+        const uint32_t method = header & METHOD_MASK;
+        const uint32_t count = (header >> METHOD_COUNT_SHIFT) & METHOD_COUNT_MASK;
+        const bool non_increasing = (header & METHOD_NON_INCREASING) != 0;
+
+        stats.methods++;
+        stats.method_counts[method / 4]++;
+        for (uint32_t i = 0; i < count && p < pEnd; i++) {
+            execute_method(non_increasing ? method : method + i * 4, *p++);
+        }
+    }
+}
+
+uint32_t *pb_push(uint32_t *p, DWORD command, DWORD nparam)
+{
+    return push_method(p, command, nparam);
+}
+
+uint32_t *pb_push1(uint32_t *p, DWORD command, DWORD param1)
+{
+    p = push_method(p, command, 1);
+    *p++ = param1;
+    return p;
+}
+
+uint32_t *pb_push2(uint32_t *p, DWORD command, DWORD param1, DWORD param2)
+{
+    p = push_method(p, command, 2);
+    *p++ = param1;
+    *p++ = param2;
+    return p;
+}
+
+uint32_t *pb_push3(uint32_t *p, DWORD command, DWORD param1, DWORD param2, DWORD param3)
+{
+    p = push_method(p, command, 3);
+    *p++ = param1;
+    *p++ = param2;
+    *p++ = param3;
+    return p;
+}
+
+uint32_t *pb_push4(uint32_t *p, DWORD command, DWORD param1, DWORD param2, DWORD param3, DWORD param4)
+{
+    p = push_method(p, command, 4);
+    *p++ = param1;
+    *p++ = param2;
+    *p++ = param3;
+    *p++ = param4;
+    return p;
+}
+
+uint32_t *pb_push4f(uint32_t *p, DWORD command, float param1, float param2, float param3, float param4)
+{
+    p = push_method(p, command, 4);
+    memcpy(p++, &param1, sizeof(float));
+    memcpy(p++, &param2, sizeof(float));
+    memcpy(p++, &param3, sizeof(float));
+    memcpy(p++, &param4, sizeof(float));
+    return p;
+}
+
+int pb_busy(void)
+{
+    return 0;
+}
+
+int pb_finished(void)
+{
+    return 0;
+}
+
+void pb_wait_for_vbl(void)
+{
+    vbl_counter++;
+}
+
+DWORD pb_get_vbl_counter(void)
+{
+    return vbl_counter;
+}
+
+void pb_show_front_screen(void)
+{
+}
+
+void pb_target_back_buffer(void)
+{
+}
+
+DWORD *pb_back_buffer(void)
+{
+    return back_buffer;
+}
+
+DWORD pb_back_buffer_width(void)
+{
+    return BACK_BUFFER_WIDTH;
+}
+
+DWORD pb_back_buffer_height(void)
+{
+    return BACK_BUFFER_HEIGHT;
+}
+
+DWORD pb_back_buffer_pitch(void)
+{
+    return BACK_BUFFER_WIDTH * sizeof(DWORD);
+}
+
+void pb_set_color_format(unsigned int fmt, bool swizzled)
+{
+    (void)fmt;
+    (void)swizzled;
+}
+
+// Pushes the same methods as pbkit's clears so they count towards the bytes per frame
+static void push_clear(int x, int y, int w, int h, DWORD method, DWORD value, DWORD flags)
+{
+    uint32_t *p = pb_begin();
+    p = pb_push2(p, NV097_SET_CLEAR_RECT_HORIZONTAL, ((x + w - 1) << 16) | x, ((y + h - 1) << 16) | y);
+    p = pb_push1(p, method, value);
+    p = pb_push1(p, NV097_CLEAR_SURFACE, flags);
+    pb_end(p);
+}
+
+void pb_fill(int x, int y, int w, int h, DWORD color)
+{
+    push_clear(x, y, w, h, NV097_SET_COLOR_CLEAR_VALUE, color, CLEAR_SURFACE_COLOR);
+}
+
+void pb_erase_depth_stencil_buffer(int x, int y, int w, int h)
+{
+    push_clear(x, y, w, h, NV097_SET_ZSTENCIL_CLEAR_VALUE, 0xFFFFFF00, CLEAR_SURFACE_ZETA);
+}
+
+void pb_print(const char *format, ...)
+{
+    (void)format;
+}
+
+void pb_erase_text_screen(void)
+{
+}
+
+void pb_draw_text_screen(void)
+{
+}
+
+void pb_create_dma_ctx(DWORD ChannelID, DWORD Class, DWORD Base, DWORD Limit, struct s_CtxDma *pDmaObject)
+{
+    (void)Base;
+    (void)Limit;
+    *pDmaObject = (struct s_CtxDma){ ChannelID, 0, Class, 0 };
+}
+
+void pb_set_dma_address(struct s_CtxDma *context, const void *address, DWORD limit)
+{
+    (void)limit;
+    if (context->ChannelID < DMA_CHANNEL_COUNT) {
+        dma_addresses[context->ChannelID] = address;
+    }
+}
+
+void pb_bind_channel(struct s_CtxDma *pContext)
+{
+    (void)pContext;
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// What the fake pbkit in fake_xbox.c saw pushed since the last fake_pb_reset_stats call
+
+#ifndef RENDER_BENCH_FAKE_XBOX_H
+#define RENDER_BENCH_FAKE_XBOX_H
+
+#include <stdint.h>
+
+#define FAKE_PB_REGISTER_COUNT (0x2000 / 4)
+
+typedef struct fake_pb_stats
+{
+    uint64_t segments; // pb_begin/pb_end pairs
+    uint64_t bytes;    // Method headers and parameters
+    uint64_t methods;  // Method headers
+    uint64_t method_counts[FAKE_PB_REGISTER_COUNT]; // Method headers by NV097 method / 4
+} fake_pb_stats_t;
+
+const fake_pb_stats_t *fake_pb_get_stats(void);
+void fake_pb_reset_stats(void);
+
+#endif
@@ -0,0 +1,260 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Runs sprite, text and primitive workloads through the XGU renderer on the host, against the fake pbkit in
+// fake_xbox.c, and reports the CPU time per SDL draw call and the pushbuffer bytes per frame. The GPU finishes
+// every frame as soon as it is pushed, so the times are the renderer's own CPU cost. See README.md for how
+// to build it.
+//   render_bench [-f frames] [-w sprites|text|primitives] [-m]
+// -m also prints the methods pushed most often by each workload.
+
+#include <SDL3/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL_render_xgu.h"
+#include "fake_xbox.h"
+
+#define WARMUP_FRAMES  30
+#define DEFAULT_FRAMES 300
+#define TOP_METHODS    10
+
+#define SPRITE_TEXTURES 4
+#define SPRITE_SIZE     32
+#define SPRITE_DRAWS    1000
+#define TEXT_LINES      40
+#define TEXT_COLUMNS    70
+#define PRIMITIVE_DRAWS 1000
+
+typedef struct bench
+{
+    SDL_Renderer *renderer;
+    SDL_Texture *sprites[SPRITE_TEXTURES];
+} bench_t;
+
+typedef struct workload
+{
+    const char *name;
+    // Queues one frame of draws and returns the number of SDL draw calls made
+    int (*draw)(bench_t *bench, int frame);
+} workload_t;
+
+// Groups of sprites share a texture and color, like a tile map or a particle system
+static int draw_sprites(bench_t *bench, int frame)
+{
+    for (int i = 0; i < SPRITE_DRAWS; i++) {
+        SDL_Texture *texture = bench->sprites[(i / 50) % SPRITE_TEXTURES];
+        const SDL_FRect dst = {
+            (float)((i * 37 + frame) % (640 - SPRITE_SIZE)),
+            (float)((i * 53 + frame * 2) % (480 - SPRITE_SIZE)),
+            SPRITE_SIZE, SPRITE_SIZE
+        };
+        SDL_SetTextureColorMod(texture, 255, (Uint8)(128 + (i / 50) * 8), 255);
+        SDL_RenderTexture(bench->renderer, texture, NULL, &dst);
+    }
+    return SPRITE_DRAWS;
+}
+
+// One SDL_RenderDebugText call per line of a full screen of text
+static int draw_text(bench_t *bench, int frame)
+{
+    char line[TEXT_COLUMNS + 1];
+    for (int i = 0; i < TEXT_LINES; i++) {
+        for (int c = 0; c < TEXT_COLUMNS; c++) {
+            line[c] = (char)(' ' + 1 + (c + i + frame) % 94);
+        }
+        line[TEXT_COLUMNS] = '\0';
+        SDL_SetRenderDrawColor(bench->renderer, 255, 255, (Uint8)(i * 6), 255);
+        SDL_RenderDebugText(bench->renderer, 4.0f, 4.0f + (float)i * 11.0f, line);
+    }
+    return TEXT_LINES;
+}
+
+// Filled rects, outlines, lines and colored triangles in turn
+static int draw_primitives(bench_t *bench, int frame)
+{
+    SDL_Renderer *renderer = bench->renderer;
+    for (int i = 0; i < PRIMITIVE_DRAWS; i++) {
+        const float x = (float)((i * 31 + frame) % 600);
+        const float y = (float)((i * 17 + frame) % 440);
+        SDL_SetRenderDrawColor(renderer, (Uint8)i, (Uint8)(i * 3), (Uint8)(i * 7), 255);
+
+        switch (i % 4) {
+        case 0:
+        {
+            const SDL_FRect rect = { x, y, 40.0f, 40.0f };
+            SDL_RenderFillRect(renderer, &rect);
+            break;
+        }
+        case 1:
+        {
+            const SDL_FRect rect = { x, y, 40.0f, 40.0f };
+            SDL_RenderRect(renderer, &rect);
+            break;
+        }
+        case 2:
+            SDL_RenderLine(renderer, x, y, x + 40.0f, y + 30.0f);
+            break;
+        case 3:
+        {
+            const SDL_Vertex vertices[3] = {
+                { { x, y }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
+                { { x + 40.0f, y }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
+                { { x, y + 40.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+            };
+            SDL_RenderGeometry(renderer, NULL, vertices, 3, NULL, 0);
+            break;
+        }
+        }
+    }
+    return PRIMITIVE_DRAWS;
+}
+
+static const workload_t workloads[] = {
+    { "sprites", draw_sprites },
+    { "text", draw_text },
+    { "primitives", draw_primitives },
+};
+
+static bool create_sprites(bench_t *bench)
+{
+    static Uint32 pixels[SPRITE_SIZE * SPRITE_SIZE];
+    for (int t = 0; t < SPRITE_TEXTURES; t++) {
+        for (int i = 0; i < SPRITE_SIZE * SPRITE_SIZE; i++) {
+            const int x = i % SPRITE_SIZE;
+            const int y = i / SPRITE_SIZE;
+            pixels[i] = ((x ^ y) & (4 << t)) ? 0xFFFFFFFF : 0x80000000 | (0x3F << (t * 6));
+        }
+        bench->sprites[t] = SDL_CreateTexture(bench->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                              SPRITE_SIZE, SPRITE_SIZE);
+        if (bench->sprites[t] == NULL ||
+            !SDL_UpdateTexture(bench->sprites[t], NULL, pixels, SPRITE_SIZE * sizeof(Uint32))) {
+            return false;
+        }
+        SDL_SetTextureBlendMode(bench->sprites[t], SDL_BLENDMODE_BLEND);
+    }
+    return true;
+}
+
+static int compare_methods(const void *a, const void *b)
+{
+    const fake_pb_stats_t *stats = fake_pb_get_stats();
+    const uint64_t count_a = stats->method_counts[*(const int *)a];
+    const uint64_t count_b = stats->method_counts[*(const int *)b];
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+static void print_top_methods(int frames)
+{
+    const fake_pb_stats_t *stats = fake_pb_get_stats();
+    static int order[FAKE_PB_REGISTER_COUNT];
+    for (int i = 0; i < FAKE_PB_REGISTER_COUNT; i++) {
+        order[i] = i;
+    }
+    qsort(order, FAKE_PB_REGISTER_COUNT, sizeof(order[0]), compare_methods);
+
+    for (int i = 0; i < TOP_METHODS && stats->method_counts[order[i]] > 0; i++) {
+        printf("    method 0x%04X %10.1f per frame\n", order[i] * 4,
+               (double)stats->method_counts[order[i]] / frames);
+    }
+}
+
+static void run_workload(bench_t *bench, const workload_t *workload, int frames, bool show_methods)
+{
+    SDL_Renderer *renderer = bench->renderer;
+    SDL_PropertiesID props = SDL_GetRendererProperties(renderer);
+    Uint64 draw_calls = 0;
+    Uint64 vertex_bytes = 0;
+    Uint64 draw_ns = 0;
+    int draws = 0;
+
+    for (int frame = 0; frame < WARMUP_FRAMES + frames; frame++) {
+        if (frame == WARMUP_FRAMES) {
+            fake_pb_reset_stats();
+            draws = 0;
+            draw_ns = 0;
+            draw_calls = 0;
+            vertex_bytes = 0;
+        }
+
+        const Uint64 start = SDL_GetTicksNS();
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draws += workload->draw(bench, frame);
+        SDL_RenderPresent(renderer);
+        draw_ns += SDL_GetTicksNS() - start;
+
+        draw_calls += SDL_GetNumberProperty(props, SDL_PROP_RENDERER_XGU_DRAW_CALLS_NUMBER, 0);
+        vertex_bytes += SDL_GetNumberProperty(props, SDL_PROP_RENDERER_XGU_VERTEX_BYTES_NUMBER, 0);
+    }
+
+    const fake_pb_stats_t *stats = fake_pb_get_stats();
+    printf("%-12s %8d %10.1f %12.0f %10.1f %12.0f\n", workload->name, draws / frames, (double)draw_ns / draws,
+           (double)stats->bytes / frames, (double)draw_calls / frames, (double)vertex_bytes / frames);
+    if (show_methods) {
+        print_top_methods(frames);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int frames = DEFAULT_FRAMES;
+    const char *only = NULL;
+    bool show_methods = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            show_methods = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-f frames] [-w sprites|text|primitives] [-m]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0) {
+        fprintf(stderr, "The number of frames must be positive\n");
+        return 1;
+    }
+
+    // Only the renderer matters, the dummy video driver gives it a window without opening anything
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    bench_t bench = { 0 };
+    SDL_Window *window = SDL_CreateWindow("render_bench", 640, 480, 0);
+    bench.renderer = (window) ? SDL_CreateRenderer(window, "nxdk_xgu") : NULL;
+    if (bench.renderer == NULL || !create_sprites(&bench)) {
+        fprintf(stderr, "Creating the renderer failed: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    printf("%d frames per workload after %d warmup frames\n", frames, WARMUP_FRAMES);
+    printf("%-12s %8s %10s %12s %10s %12s\n", "workload", "draws", "ns/draw", "bytes/frame", "gpu draws",
+           "vertex bytes");
+    bool found = false;
+    for (size_t i = 0; i < SDL_arraysize(workloads); i++) {
+        if (only == NULL || strcmp(only, workloads[i].name) == 0) {
+            run_workload(&bench, &workloads[i], frames, show_methods);
+            found = true;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "Unknown workload %s\n", only);
+    }
+
+    for (int t = 0; t < SPRITE_TEXTURES; t++) {
+        SDL_DestroyTexture(bench.sprites[t]);
+    }
+    SDL_DestroyRenderer(bench.renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return found ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Video mode functions used by the renderer. fake_xbox.c reports a 640x480 32-bit mode at 60Hz.
+
+#ifndef RENDER_BENCH_STUB_HAL_VIDEO_H
+#define RENDER_BENCH_STUB_HAL_VIDEO_H
+
+#include <stdbool.h>
+
+typedef struct _VIDEO_MODE
+{
+    int width;
+    int height;
+    int bpp;
+    int refresh;
+} VIDEO_MODE;
+
+VIDEO_MODE XVideoGetMode(void);
+void XVideoFlushFB(void);
+void XVideoSetVideoEnable(bool enable);
+
+#endif
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// The parts of pbkit used by xgu and the renderer. fake_xbox.c implements them on top of a host buffer: every
+// segment closed with pb_end is decoded, its methods are counted and semaphore releases are written to memory
+// straight away, so every frame has finished as soon as it is pushed. The NV097 method definitions come from
+// nxdk's own nv_regs.h, which CMakeLists.txt copies into the build directory.
+
+#ifndef RENDER_BENCH_STUB_PBKIT_H
+#define RENDER_BENCH_STUB_PBKIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pbkit/nv_regs.h>
+#include <windows.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#define MAXRAM 0x03FFAFFF
+
+#define DMA_CLASS_3D               0x3D
+#define DMA_CHANNEL_PIXEL_RENDERER 9
+
+struct s_CtxDma
+{
+    DWORD ChannelID;
+    DWORD Inst;
+    DWORD Class;
+    DWORD isGr;
+};
+
+int pb_init(void);
+void pb_kill(void);
+void pb_reset(void);
+
+uint32_t *pb_begin(void);
+void pb_end(uint32_t *pEnd);
+uint32_t *pb_push(uint32_t *p, DWORD command, DWORD nparam);
+uint32_t *pb_push1(uint32_t *p, DWORD command, DWORD param1);
+uint32_t *pb_push2(uint32_t *p, DWORD command, DWORD param1, DWORD param2);
+uint32_t *pb_push3(uint32_t *p, DWORD command, DWORD param1, DWORD param2, DWORD param3);
+uint32_t *pb_push4(uint32_t *p, DWORD command, DWORD param1, DWORD param2, DWORD param3, DWORD param4);
+uint32_t *pb_push4f(uint32_t *p, DWORD command, float param1, float param2, float param3, float param4);
+
+int pb_busy(void);
+int pb_finished(void);
+void pb_wait_for_vbl(void);
+DWORD pb_get_vbl_counter(void);
+
+void pb_show_front_screen(void);
+void pb_target_back_buffer(void);
+DWORD *pb_back_buffer(void);
+DWORD pb_back_buffer_width(void);
+DWORD pb_back_buffer_height(void);
+DWORD pb_back_buffer_pitch(void);
+void pb_set_color_format(unsigned int fmt, bool swizzled);
+
+void pb_fill(int x, int y, int w, int h, DWORD color);
+void pb_erase_depth_stencil_buffer(int x, int y, int w, int h);
+
+void pb_print(const char *format, ...);
+void pb_erase_text_screen(void);
+void pb_draw_text_screen(void);
+
+void pb_create_dma_ctx(DWORD ChannelID, DWORD Class, DWORD Base, DWORD Limit, struct s_CtxDma *pDmaObject);
+void pb_set_dma_address(struct s_CtxDma *context, const void *address, DWORD limit);
+void pb_bind_channel(struct s_CtxDma *pContext);
+
+#endif
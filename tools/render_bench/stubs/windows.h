@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// The parts of nxdk's winapi used by the renderer, implemented in fake_xbox.c
+
+#ifndef RENDER_BENCH_STUB_WINDOWS_H
+#define RENDER_BENCH_STUB_WINDOWS_H
+
+#include <stdint.h>
+
+typedef uint32_t DWORD;
+typedef int BOOL;
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+void Sleep(DWORD dwMilliseconds);
+
+#endif
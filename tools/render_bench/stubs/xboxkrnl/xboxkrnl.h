@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Kernel declarations used by the renderer and the contiguous heap. fake_xbox.c backs contiguous memory with
+// page aligned host memory.
+
+#ifndef RENDER_BENCH_STUB_XBOXKRNL_H
+#define RENDER_BENCH_STUB_XBOXKRNL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned long ULONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef void *PVOID;
+
+#define PAGE_SIZE         4096
+#define PAGE_READWRITE    0x04
+#define PAGE_NOCACHE      0x200
+#define PAGE_WRITECOMBINE 0x400
+
+PVOID MmAllocateContiguousMemory(SIZE_T NumberOfBytes);
+PVOID MmAllocateContiguousMemoryEx(SIZE_T NumberOfBytes, ULONG_PTR LowestAcceptableAddress,
+                                   ULONG_PTR HighestAcceptableAddress, ULONG_PTR Alignment, ULONG ProtectionType);
+void MmFreeContiguousMemory(PVOID BaseAddress);
+ULONG_PTR MmGetPhysicalAddress(PVOID BaseAddress);
+ULONG DbgPrint(const char *Format, ...);
+
+#endif
@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Decodes a pushbuffer capture written by SDL_XGU_CapturePushbuffer and reports the bytes pushed per frame and
+// per render command, state methods that did not change their register, and a histogram of draw sizes.
+// Builds on the host machine:
+//   cc -O2 -o xgu_capture_analyze tools/xgu_capture_analyze.c -Inxdk_glue/render
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xgu_capture.h"
+
+// NV097 methods that the analyzer needs to understand, from nv2a_regs.h
+#define NV097_NO_OPERATION                     0x0100
+#define NV097_WAIT_FOR_IDLE                    0x0110
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT     0x1760
+#define NV097_SET_BEGIN_END                    0x17FC
+#define NV097_ARRAY_ELEMENT16                  0x1800
+#define NV097_ARRAY_ELEMENT32                  0x1808
+#define NV097_DRAW_ARRAYS                      0x1810
+#define NV097_INLINE_ARRAY                     0x1818
+#define NV097_SET_SEMAPHORE_OFFSET             0x1D6C
+#define NV097_BACK_END_WRITE_SEMAPHORE_RELEASE 0x1D70
+#define NV097_CLEAR_SURFACE                    0x1D94
+
+#define METHOD_MASK           0x1FFC
+#define METHOD_COUNT_SHIFT    18
+#define METHOD_COUNT_MASK     0x7FF
+#define METHOD_NON_INCREASING 0x40000000
+// Jumps, calls and returns are written by pbkit itself and never appear inside a captured segment
+#define METHOD_CONTROL_BITS   0xA0000003
+
+#define REGISTER_COUNT   (0x2000 / 4)
+#define ATTRIBUTE_COUNT  16
+#define HISTOGRAM_BUCKETS 16
+
+typedef struct frame_stats
+{
+    uint64_t bytes;
+    uint64_t draws;
+    uint64_t redundant;
+} frame_stats_t;
+
+typedef struct analysis
+{
+    // Last value written to each register, and whether it is known
+    uint32_t value[REGISTER_COUNT];
+    bool valid[REGISTER_COUNT];
+
+    uint64_t method_writes[REGISTER_COUNT];
+    uint64_t redundant_writes[REGISTER_COUNT];
+    uint64_t tag_bytes[XGU_CAPTURE_TAG_COUNT + 1];
+    uint64_t tag_records[XGU_CAPTURE_TAG_COUNT + 1];
+
+    // Draw being decoded between SET_BEGIN_END(primitive) and SET_BEGIN_END(0)
+    bool in_draw;
+    uint64_t draw_vertices;
+    uint64_t draw_inline_dwords;
+    bool draw_indexed;
+    uint64_t histogram[HISTOGRAM_BUCKETS];
+    uint64_t inline_draws;
+    uint64_t indexed_draws;
+    uint64_t array_draws;
+
+    frame_stats_t *frames;
+    uint32_t frame_count;
+    uint64_t segments;
+    uint64_t bad_methods;
+} analysis_t;
+
+// Methods that start work on the GPU rather than set state, so writing the same value again is not redundant
+static bool is_trigger(uint32_t method)
+{
+    switch (method) {
+    case NV097_NO_OPERATION:
+    case NV097_WAIT_FOR_IDLE:
+    case NV097_SET_BEGIN_END:
+    case NV097_ARRAY_ELEMENT16:
+    case NV097_ARRAY_ELEMENT32:
+    case NV097_DRAW_ARRAYS:
+    case NV097_INLINE_ARRAY:
+    case NV097_SET_SEMAPHORE_OFFSET:
+    case NV097_BACK_END_WRITE_SEMAPHORE_RELEASE:
+    case NV097_CLEAR_SURFACE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Size of one vertex pushed with INLINE_ARRAY, from the enabled vertex attribute formats
+static uint32_t inline_vertex_dwords(const analysis_t *a)
+{
+    uint32_t dwords = 0;
+    for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+        const uint32_t reg = NV097_SET_VERTEX_DATA_ARRAY_FORMAT / 4 + i;
+        if (!a->valid[reg]) {
+            continue;
+        }
+        const uint32_t type = a->value[reg] & 0xF;
+        const uint32_t size = (a->value[reg] >> 4) & 0xF;
+        // Types 0 and 4 are unsigned bytes, 1 and 5 are shorts, 6 is a packed dword and 2 and 3 are floats
+        const uint32_t component_bytes = (type == 0 || type == 4) ? 1 : (type == 1 || type == 5) ? 2 : 4;
+        const uint32_t bytes = (type == 6) ? 4 * (size != 0) : size * component_bytes;
+        dwords += (bytes + 3) / 4;
+    }
+    return dwords;
+}
+
+static int histogram_bucket(uint64_t vertices)
+{
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && (2ULL << bucket) <= vertices) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void end_draw(analysis_t *a)
+{
+    uint64_t vertices = a->draw_vertices;
+    if (a->draw_inline_dwords) {
+        const uint32_t vertex_dwords = inline_vertex_dwords(a);
+        vertices += (vertex_dwords) ? a->draw_inline_dwords / vertex_dwords : 0;
+        a->inline_draws++;
+    } else if (a->draw_indexed) {
+        a->indexed_draws++;
+    } else {
+        a->array_draws++;
+    }
+    a->histogram[histogram_bucket(vertices)]++;
+    a->frames[a->frame_count - 1].draws++;
+    a->in_draw = false;
+}
+
+static void method_write(analysis_t *a, uint32_t method, uint32_t value)
+{
+    const uint32_t reg = method / 4;
+    a->method_writes[reg]++;
+
+    switch (method) {
+    case NV097_SET_BEGIN_END:
+        if (a->in_draw) {
+            end_draw(a);
+        }
+        if (value != 0) {
+            a->in_draw = true;
+            a->draw_vertices = 0;
+            a->draw_inline_dwords = 0;
+            a->draw_indexed = false;
+        }
+        break;
+    case NV097_DRAW_ARRAYS:
+        a->draw_vertices += (value >> 24) + 1;
+        break;
+    case NV097_ARRAY_ELEMENT16:
+        a->draw_indexed = true;
+        a->draw_vertices += 2;
+        break;
+    case NV097_ARRAY_ELEMENT32:
+        a->draw_indexed = true;
+        a->draw_vertices += 1;
+        break;
+    case NV097_INLINE_ARRAY:
+        a->draw_inline_dwords++;
+        break;
+    default:
+        break;
+    }
+
+    if (is_trigger(method)) {
+        return;
+    }
+    if (a->valid[reg] && a->value[reg] == value) {
+        a->redundant_writes[reg]++;
+        a->frames[a->frame_count - 1].redundant++;
+    }
+    a->value[reg] = value;
+    a->valid[reg] = true;
+}
+
+static void decode(analysis_t *a, const uint32_t *dwords, uint32_t count)
+{
+    uint32_t i = 0;
+    while (i < count) {
+        const uint32_t header = dwords[i++];
+        if (header == 0) {
+            continue;
+        }
+        if ((header & METHOD_CONTROL_BITS) != 0) {
+            a->bad_methods++;
+            return;
+        }
+
+        const uint32_t method = header & METHOD_MASK;
+        const uint32_t method_count = (header >> METHOD_COUNT_SHIFT) & METHOD_COUNT_MASK;
+        const bool non_increasing = (header & METHOD_NON_INCREASING) != 0;
+        if (method_count > count - i) {
+            a->bad_methods++;
+            return;
+        }
+        for (uint32_t n = 0; n < method_count; n++) {
+            const uint32_t target = (non_increasing) ? method : ((method + n * 4) & METHOD_MASK);
+            method_write(a, target, dwords[i + n]);
+        }
+        i += method_count;
+    }
+}
+
+static bool read_capture(analysis_t *a, FILE *file)
+{
+    xgu_capture_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != XGU_CAPTURE_MAGIC) {
+        fprintf(stderr, "Not an XGU pushbuffer capture\n");
+        return false;
+    }
+    if (header.version != XGU_CAPTURE_VERSION) {
+        fprintf(stderr, "Unsupported capture version %u\n", header.version);
+        return false;
+    }
+
+    uint32_t *dwords = NULL;
+    uint32_t dwords_capacity = 0;
+    xgu_capture_record_t record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.dword_count > dwords_capacity) {
+            free(dwords);
+            dwords_capacity = record.dword_count;
+            dwords = malloc(dwords_capacity * sizeof(uint32_t));
+            if (dwords == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return false;
+            }
+        }
+        if (fread(dwords, sizeof(uint32_t), record.dword_count, file) != record.dword_count) {
+            fprintf(stderr, "Capture is truncated\n");
+            break;
+        }
+
+        if (record.frame >= a->frame_count) {
+            frame_stats_t *frames = realloc(a->frames, (record.frame + 1) * sizeof(frame_stats_t));
+            if (frames == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                free(dwords);
+                return false;
+            }
+            memset(&frames[a->frame_count], 0, (record.frame + 1 - a->frame_count) * sizeof(frame_stats_t));
+            a->frames = frames;
+            a->frame_count = record.frame + 1;
+        }
+
+        const uint16_t tag = (record.tag < XGU_CAPTURE_TAG_COUNT) ? record.tag : XGU_CAPTURE_TAG_COUNT;
+        a->tag_bytes[tag] += record.dword_count * sizeof(uint32_t);
+        a->tag_records[tag]++;
+        a->frames[record.frame].bytes += record.dword_count * sizeof(uint32_t);
+        a->segments += (record.flags & XGU_CAPTURE_FLAG_SEGMENT_END) != 0;
+        decode(a, dwords, record.dword_count);
+    }
+    free(dwords);
+    return true;
+}
+
+static void print_report(const analysis_t *a, bool per_frame)
+{
+    uint64_t total_bytes = 0, total_draws = 0, total_redundant = 0;
+    uint64_t min_bytes = UINT64_MAX, max_bytes = 0;
+    for (uint32_t i = 0; i < a->frame_count; i++) {
+        total_bytes += a->frames[i].bytes;
+        total_draws += a->frames[i].draws;
+        total_redundant += a->frames[i].redundant;
+        min_bytes = (a->frames[i].bytes < min_bytes) ? a->frames[i].bytes : min_bytes;
+        max_bytes = (a->frames[i].bytes > max_bytes) ? a->frames[i].bytes : max_bytes;
+    }
+    const uint32_t frames = (a->frame_count) ? a->frame_count : 1;
+
+    printf("Frames: %u, pushbuffer segments: %llu\n", a->frame_count, (unsigned long long)a->segments);
+    printf("Bytes per frame: min %llu, avg %llu, max %llu\n", (unsigned long long)((a->frame_count) ? min_bytes : 0),
+           (unsigned long long)(total_bytes / frames), (unsigned long long)max_bytes);
+    printf("Draws per frame: %.1f, redundant state writes per frame: %.1f\n", (double)total_draws / frames,
+           (double)total_redundant / frames);
+    if (a->bad_methods) {
+        printf("Segments with undecodable methods: %llu\n", (unsigned long long)a->bad_methods);
+    }
+
+    printf("\nBytes by render command:\n");
+    for (int tag = 0; tag <= XGU_CAPTURE_TAG_COUNT; tag++) {
+        if (a->tag_records[tag] == 0) {
+            continue;
+        }
+        printf("  %-16s %10llu bytes %8llu records %8.1f bytes/frame\n", xgu_capture_tag_name((uint16_t)tag),
+               (unsigned long long)a->tag_bytes[tag], (unsigned long long)a->tag_records[tag],
+               (double)a->tag_bytes[tag] / frames);
+    }
+
+    printf("\nRedundant state writes (method, redundant / total):\n");
+    for (uint32_t reg = 0; reg < REGISTER_COUNT; reg++) {
+        if (a->redundant_writes[reg]) {
+            printf("  0x%04X %10llu / %llu\n", reg * 4, (unsigned long long)a->redundant_writes[reg],
+                   (unsigned long long)a->method_writes[reg]);
+        }
+    }
+
+    printf("\nDraw sizes in vertices (%llu indexed, %llu arrays, %llu inline):\n", (unsigned long long)a->indexed_draws,
+           (unsigned long long)a->array_draws, (unsigned long long)a->inline_draws);
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        if (a->histogram[bucket] == 0) {
+            continue;
+        }
+        const unsigned long long low = (bucket == 0) ? 0 : (1ULL << bucket);
+        if (bucket == HISTOGRAM_BUCKETS - 1) {
+            printf("  %6llu+       %10llu\n", low, (unsigned long long)a->histogram[bucket]);
+        } else {
+            printf("  %6llu-%-6llu %10llu\n", low, (2ULL << bucket) - 1, (unsigned long long)a->histogram[bucket]);
+        }
+    }
+
+    if (per_frame) {
+        printf("\nFrame      bytes  draws  redundant\n");
+        for (uint32_t i = 0; i < a->frame_count; i++) {
+            printf("%5u %10llu %6llu %10llu\n", i, (unsigned long long)a->frames[i].bytes,
+                   (unsigned long long)a->frames[i].draws, (unsigned long long)a->frames[i].redundant);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool per_frame = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) {
+            per_frame = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "Usage: %s [-f] capture.bin\n  -f  also list every frame\n", argv[0]);
+        return 2;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    analysis_t *a = calloc(1, sizeof(analysis_t));
+    if (a == NULL) {
+        fclose(file);
+        return 1;
+    }
+    const bool ok = read_capture(a, file);
+    fclose(file);
+    if (ok) {
+        print_report(a, per_frame);
+    }
+    free(a->frames);
+    free(a);
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Compresses an image to DXT1, DXT3 or DXT5 for the XGU renderer's compressed textures.
+// Builds on the host machine:
+//   cc -O2 -o xgu_dxt_encode tools/xgu_dxt_encode.c
+//
+// The input is a binary PPM (P6) or PAM (P7, RGB or RGB_ALPHA) image with 8 bits per channel, which most image
+// tools can write, for example "convert image.png image.pam". The output starts with a 16 byte header of
+// little endian uint32_t values { 'XDXT', format, width, height }, where format is the SDL_XGU_CompressedFormat
+// value, followed by the rows of 4x4 blocks that SDL_PROP_TEXTURE_CREATE_XGU_COMPRESSED_DATA_POINTER expects.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XDXT_MAGIC 0x54584458 // "XDXT"
+
+// Same values as SDL_XGU_CompressedFormat
+enum dxt_format
+{
+    DXT1 = 1,
+    DXT3 = 2,
+    DXT5 = 3,
+};
+
+typedef struct image
+{
+    int width;
+    int height;
+    uint8_t *rgba;
+} image_t;
+
+static int read_token(FILE *file, char *token, int size)
+{
+    int c = fgetc(file);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        if (c == '#') {
+            while (c != '\n' && c != EOF) {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+    int length = 0;
+    while (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n' && length < size - 1) {
+        token[length++] = (char)c;
+        c = fgetc(file);
+    }
+    token[length] = '\0';
+    return length;
+}
+
+static bool read_image(const char *path, image_t *image)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char token[64];
+    int channels = 3, maxval = 0;
+    read_token(file, token, sizeof(token));
+    if (strcmp(token, "P6") == 0) {
+        read_token(file, token, sizeof(token));
+        image->width = atoi(token);
+        read_token(file, token, sizeof(token));
+        image->height = atoi(token);
+        read_token(file, token, sizeof(token));
+        maxval = atoi(token);
+    } else if (strcmp(token, "P7") == 0) {
+        while (read_token(file, token, sizeof(token)) && strcmp(token, "ENDHDR") != 0) {
+            char value[64];
+            read_token(file, value, sizeof(value));
+            if (strcmp(token, "WIDTH") == 0) {
+                image->width = atoi(value);
+            } else if (strcmp(token, "HEIGHT") == 0) {
+                image->height = atoi(value);
+            } else if (strcmp(token, "DEPTH") == 0) {
+                channels = atoi(value);
+            } else if (strcmp(token, "MAXVAL") == 0) {
+                maxval = atoi(value);
+            }
+        }
+    } else {
+        fprintf(stderr, "%s: only binary PPM and PAM images are supported\n", path);
+        fclose(file);
+        return false;
+    }
+
+    if (image->width <= 0 || image->height <= 0 || maxval != 255 || (channels != 3 && channels != 4)) {
+        fprintf(stderr, "%s: only 8-bit RGB or RGBA images are supported\n", path);
+        fclose(file);
+        return false;
+    }
+
+    const size_t pixels = (size_t)image->width * image->height;
+    uint8_t *data = malloc(pixels * channels);
+    image->rgba = malloc(pixels * 4);
+    if (data == NULL || image->rgba == NULL || fread(data, channels, pixels, file) != pixels) {
+        fprintf(stderr, "%s: could not read the pixels\n", path);
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    for (size_t i = 0; i < pixels; i++) {
+        image->rgba[i * 4 + 0] = data[i * channels + 0];
+        image->rgba[i * 4 + 1] = data[i * channels + 1];
+        image->rgba[i * 4 + 2] = data[i * channels + 2];
+        image->rgba[i * 4 + 3] = (channels == 4) ? data[i * channels + 3] : 255;
+    }
+    free(data);
+    return true;
+}
+
+static void put16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t pack565(const int *rgb)
+{
+    return (uint16_t)(((rgb[0] * 31 + 127) / 255) << 11 | ((rgb[1] * 63 + 127) / 255) << 5 | ((rgb[2] * 31 + 127) / 255));
+}
+
+static void unpack565(uint16_t color, int *rgb)
+{
+    rgb[0] = ((color >> 11) & 31) * 255 / 31;
+    rgb[1] = ((color >> 5) & 63) * 255 / 63;
+    rgb[2] = (color & 31) * 255 / 31;
+}
+
+// Encodes the colour half of a block. The endpoints are the corners of the colour bounding box, inset slightly
+// so that the interpolated colours cover the block better. With transparent set, the 3 colour mode is used and
+// pixels with alpha below 128 get index 3, which DXT1 decodes as transparent black.
+static void encode_color(const uint8_t block[16][4], bool transparent, uint8_t *dst)
+{
+    int min[3] = { 255, 255, 255 }, max[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        if (transparent && block[i][3] < 128) {
+            continue;
+        }
+        for (int c = 0; c < 3; c++) {
+            min[c] = (block[i][c] < min[c]) ? block[i][c] : min[c];
+            max[c] = (block[i][c] > max[c]) ? block[i][c] : max[c];
+        }
+    }
+    if (min[0] > max[0]) {
+        memset(min, 0, sizeof(min));
+        memset(max, 0, sizeof(max));
+    }
+    for (int c = 0; c < 3; c++) {
+        const int inset = (max[c] - min[c]) / 16;
+        min[c] += inset;
+        max[c] -= inset;
+    }
+
+    uint16_t c0 = pack565(max), c1 = pack565(min);
+    // 4 colour mode needs c0 > c1 and 3 colour mode needs c0 <= c1
+    if ((!transparent && c0 < c1) || (transparent && c0 > c1)) {
+        const uint16_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+    if (!transparent && c0 == c1) {
+        // Every pixel uses c0, index 0
+        put16(dst, c0);
+        put16(dst + 2, c1);
+        memset(dst + 4, 0, 4);
+        return;
+    }
+
+    int palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    const int palette_size = (transparent) ? 3 : 4;
+    for (int c = 0; c < 3; c++) {
+        if (transparent) {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+        } else {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+    }
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, best_error = INT32_MAX;
+        if (transparent && block[i][3] < 128) {
+            best = 3;
+        } else {
+            for (int p = 0; p < palette_size; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int d = block[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+    }
+
+    put16(dst, c0);
+    put16(dst + 2, c1);
+    for (int i = 0; i < 4; i++) {
+        dst[4 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+static void encode_alpha_explicit(const uint8_t block[16][4], uint8_t *dst)
+{
+    memset(dst, 0, 8);
+    for (int i = 0; i < 16; i++) {
+        const int alpha = (block[i][3] * 15 + 127) / 255;
+        dst[i / 2] |= (uint8_t)(alpha << ((i % 2) * 4));
+    }
+}
+
+static void encode_alpha_interpolated(const uint8_t block[16][4], uint8_t *dst)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = (block[i][3] > a0) ? block[i][3] : a0;
+        a1 = (block[i][3] < a1) ? block[i][3] : a1;
+    }
+
+    // With a0 > a1 there are 6 interpolated values between the endpoints
+    int palette[8] = { a0, a1 };
+    for (int p = 1; p < 7; p++) {
+        palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16 && a0 != a1; i++) {
+        int best = 0, best_error = INT32_MAX;
+        for (int p = 0; p < 8; p++) {
+            const int error = abs(block[i][3] - palette[p]);
+            if (error < best_error) {
+                best_error = error;
+                best = p;
+            }
+        }
+        indices |= (uint64_t)best << (i * 3);
+    }
+
+    dst[0] = (uint8_t)a0;
+    dst[1] = (uint8_t)a1;
+    for (int i = 0; i < 6; i++) {
+        dst[2 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+static void encode_block(const image_t *image, int bx, int by, enum dxt_format format, uint8_t *dst)
+{
+    // Pixels past the edge of the image repeat the last row or column
+    uint8_t block[16][4];
+    bool transparent = false;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int sx = (bx * 4 + x < image->width) ? bx * 4 + x : image->width - 1;
+            const int sy = (by * 4 + y < image->height) ? by * 4 + y : image->height - 1;
+            memcpy(block[y * 4 + x], &image->rgba[((size_t)sy * image->width + sx) * 4], 4);
+            transparent |= block[y * 4 + x][3] < 128;
+        }
+    }
+
+    switch (format) {
+    case DXT1:
+        encode_color(block, transparent, dst);
+        break;
+    case DXT3:
+        encode_alpha_explicit(block, dst);
+        encode_color(block, false, dst + 8);
+        break;
+    case DXT5:
+        encode_alpha_interpolated(block, dst);
+        encode_color(block, false, dst + 8);
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4 || (strcmp(argv[1], "dxt1") != 0 && strcmp(argv[1], "dxt3") != 0 && strcmp(argv[1], "dxt5") != 0)) {
+        fprintf(stderr, "Usage: %s dxt1|dxt3|dxt5 input.pam output.xdxt\n", argv[0]);
+        return 2;
+    }
+    const enum dxt_format format = (argv[1][3] == '1') ? DXT1 : (argv[1][3] == '3') ? DXT3 : DXT5;
+    const int block_size = (format == DXT1) ? 8 : 16;
+
+    image_t image = { 0 };
+    if (!read_image(argv[2], &image)) {
+        free(image.rgba);
+        return 1;
+    }
+
+    const int block_columns = (image.width + 3) / 4;
+    const int block_rows = (image.height + 3) / 4;
+    const size_t size = (size_t)block_columns * block_rows * block_size;
+    uint8_t *blocks = malloc(size);
+    if (blocks == NULL) {
+        free(image.rgba);
+        return 1;
+    }
+    for (int by = 0; by < block_rows; by++) {
+        for (int bx = 0; bx < block_columns; bx++) {
+            encode_block(&image, bx, by, format, &blocks[((size_t)by * block_columns + bx) * block_size]);
+        }
+    }
+
+    FILE *out = fopen(argv[3], "wb");
+    if (out == NULL) {
+        perror(argv[3]);
+        free(blocks);
+        free(image.rgba);
+        return 1;
+    }
+    const uint32_t header[4] = { XDXT_MAGIC, format, (uint32_t)image.width, (uint32_t)image.height };
+    uint8_t header_bytes[16];
+    for (int i = 0; i < 16; i++) {
+        header_bytes[i] = (uint8_t)(header[i / 4] >> ((i % 4) * 8));
+    }
+    const bool ok = fwrite(header_bytes, sizeof(header_bytes), 1, out) == 1 && fwrite(blocks, size, 1, out) == 1;
+    fclose(out);
+
+    if (ok) {
+        printf("%s: %dx%d, %zu bytes of blocks, %zu bytes as 32-bit pixels\n", argv[3], image.width, image.height,
+               size, (size_t)image.width * image.height * 4);
+    }
+    free(blocks);
+    free(image.rgba);
+    return (ok) ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2025 Ryan Wendland
+
+// Times swizzle_rect and unswizzle_rect against the per-pixel loop they replaced, at 2 and 4 bytes per pixel,
+// and checks that both produce the same texture. Swizzled textures are power of two sized.
+// Builds on the host machine:
+//   cc -O2 -o xgu_swizzle_bench tools/xgu_swizzle_bench.c nxdk_glue/render/swizzle.c -Inxdk_glue/render
+// Building with -m32 -march=pentium3 gets closer to the Xbox CPU.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "swizzle.h"
+
+// Enough iterations of the smallest size to get a stable timing, larger sizes run fewer
+#define BENCH_PIXELS (16 * 1024 * 1024)
+
+typedef struct bench_size
+{
+    unsigned int width;
+    unsigned int height;
+} bench_size_t;
+
+static const bench_size_t sizes[] = {
+    { 16, 16 },
+    { 32, 32 },
+    { 64, 64 },
+    { 256, 256 },
+    { 512, 256 },
+    { 512, 512 },
+    { 1024, 1024 },
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Same mask generation as swizzle.c
+static void generate_masks(unsigned int width, unsigned int height, uint32_t *mask_x, uint32_t *mask_y)
+{
+    uint32_t x = 0, y = 0;
+    uint32_t mask_bit = 1;
+    for (uint32_t bit = 1; bit < width || bit < height; bit <<= 1) {
+        if (bit < width) {
+            x |= mask_bit;
+            mask_bit <<= 1;
+        }
+        if (bit < height) {
+            y |= mask_bit;
+            mask_bit <<= 1;
+        }
+    }
+    *mask_x = x;
+    *mask_y = y;
+}
+
+// The per-pixel loop swizzle_rect used before the tiled path
+static inline void baseline_swizzle_internal(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,
+                             unsigned int row_pitch, unsigned int bytes_per_pixel)
+{
+    uint32_t mask_x, mask_y;
+    generate_masks(width, height, &mask_x, &mask_y);
+
+    uint32_t off_y = 0;
+    for (unsigned int y = 0; y < height; y++) {
+        uint32_t off_x = 0;
+        const uint8_t *src_tmp = src_buf + y * row_pitch;
+        uint8_t *dst_tmp = dst_buf + off_y * bytes_per_pixel;
+        for (unsigned int x = 0; x < width; x++) {
+            memcpy(dst_tmp + off_x * bytes_per_pixel, src_tmp + x * bytes_per_pixel, bytes_per_pixel);
+            off_x = (off_x - mask_x) & mask_x;
+        }
+        off_y = (off_y - mask_y) & mask_y;
+    }
+}
+
+static inline void baseline_unswizzle_internal(const uint8_t *src_buf, unsigned int width, unsigned int height,
+                                               uint8_t *dst_buf, unsigned int row_pitch, unsigned int bytes_per_pixel)
+{
+    uint32_t mask_x, mask_y;
+    generate_masks(width, height, &mask_x, &mask_y);
+
+    uint32_t off_y = 0;
+    for (unsigned int y = 0; y < height; y++) {
+        uint32_t off_x = 0;
+        const uint8_t *src_tmp = src_buf + off_y * bytes_per_pixel;
+        uint8_t *dst_tmp = dst_buf + y * row_pitch;
+        for (unsigned int x = 0; x < width; x++) {
+            memcpy(dst_tmp + x * bytes_per_pixel, src_tmp + off_x * bytes_per_pixel, bytes_per_pixel);
+            off_x = (off_x - mask_x) & mask_x;
+        }
+        off_y = (off_y - mask_y) & mask_y;
+    }
+}
+
+// Specialised for the common bytes_per_pixel like the old code was
+#define MULTIVERSION(m)                                                                                        \
+    static void m(const uint8_t *src_buf, unsigned int width, unsigned int height, uint8_t *dst_buf,          \
+                  unsigned int row_pitch, unsigned int bytes_per_pixel)                                       \
+    {                                                                                                         \
+        switch (bytes_per_pixel) {                                                                            \
+        case 2:                                                                                               \
+            m##_internal(src_buf, width, height, dst_buf, row_pitch, 2);                                      \
+            break;                                                                                            \
+        case 4:                                                                                               \
+            m##_internal(src_buf, width, height, dst_buf, row_pitch, 4);                                      \
+            break;                                                                                            \
+        default:                                                                                              \
+            m##_internal(src_buf, width, height, dst_buf, row_pitch, bytes_per_pixel);                        \
+        }                                                                                                     \
+    }
+
+MULTIVERSION(baseline_swizzle)
+MULTIVERSION(baseline_unswizzle)
+
+#undef MULTIVERSION
+
+typedef void (*rect_function_t)(const uint8_t *, unsigned int, unsigned int, uint8_t *, unsigned int, unsigned int);
+
+static double time_ns_per_pixel(rect_function_t function, const uint8_t *src, unsigned int width,
+                                unsigned int height, uint8_t *dst, unsigned int pitch, unsigned int bytes_per_pixel)
+{
+    const unsigned int iterations = BENCH_PIXELS / (width * height);
+    const uint64_t start = now_ns();
+    for (unsigned int i = 0; i < iterations; i++) {
+        function(src, width, height, dst, pitch, bytes_per_pixel);
+    }
+    return (double)(now_ns() - start) / ((double)iterations * width * height);
+}
+
+static void tiled_swizzle(const uint8_t *src, unsigned int width, unsigned int height, uint8_t *dst,
+                          unsigned int pitch, unsigned int bytes_per_pixel)
+{
+    swizzle_rect(src, width, height, dst, pitch, bytes_per_pixel);
+}
+
+static void tiled_unswizzle(const uint8_t *src, unsigned int width, unsigned int height, uint8_t *dst,
+                            unsigned int pitch, unsigned int bytes_per_pixel)
+{
+    unswizzle_rect(src, width, height, dst, pitch, bytes_per_pixel);
+}
+
+// Checks the tiled path against the baseline, including a subrect that doesn't line up with the tiles
+static bool verify(unsigned int width, unsigned int height, unsigned int bytes_per_pixel)
+{
+    const size_t size = (size_t)width * height * bytes_per_pixel;
+    const unsigned int pitch = width * bytes_per_pixel;
+    uint8_t *linear = malloc(size);
+    uint8_t *expected = malloc(size);
+    uint8_t *actual = malloc(size);
+    bool ok = true;
+
+    for (size_t i = 0; i < size; i++) {
+        linear[i] = (uint8_t)(rand() & 0xFF);
+    }
+
+    baseline_swizzle(linear, width, height, expected, pitch, bytes_per_pixel);
+    swizzle_rect(linear, width, height, actual, pitch, bytes_per_pixel);
+    if (memcmp(expected, actual, size) != 0) {
+        printf("FAIL swizzle_rect %ux%u %ubpp\n", width, height, bytes_per_pixel);
+        ok = false;
+    }
+
+    baseline_unswizzle(expected, width, height, actual, pitch, bytes_per_pixel);
+    if (memcmp(linear, actual, size) != 0) {
+        printf("FAIL baseline round trip %ux%u %ubpp\n", width, height, bytes_per_pixel);
+        ok = false;
+    }
+    unswizzle_rect(expected, width, height, actual, pitch, bytes_per_pixel);
+    if (memcmp(linear, actual, size) != 0) {
+        printf("FAIL unswizzle_rect %ux%u %ubpp\n", width, height, bytes_per_pixel);
+        ok = false;
+    }
+
+    if (width > 2 && height > 2) {
+        // Update an inner rect of the swizzled texture and compare with swizzling the whole updated image
+        const unsigned int x = 1, y = 1, w = width - 2, h = height - 2;
+        for (unsigned int row = y; row < y + h; row++) {
+            for (unsigned int i = x * bytes_per_pixel; i < (x + w) * bytes_per_pixel; i++) {
+                linear[row * pitch + i] = (uint8_t)(rand() & 0xFF);
+            }
+        }
+        memcpy(actual, expected, size);
+        swizzle_subrect(linear + y * pitch + x * bytes_per_pixel, x, y, w, h, actual, width, height, pitch,
+                        bytes_per_pixel);
+        baseline_swizzle(linear, width, height, expected, pitch, bytes_per_pixel);
+        if (memcmp(expected, actual, size) != 0) {
+            printf("FAIL swizzle_subrect %ux%u %ubpp\n", width, height, bytes_per_pixel);
+            ok = false;
+        }
+    }
+
+    free(linear);
+    free(expected);
+    free(actual);
+    return ok;
+}
+
+int main(void)
+{
+    const unsigned int bpps[] = { 2, 4 };
+    bool ok = true;
+
+    // Verify every power of two size up to 1024 in both directions, 1 byte per pixel is used by INDEX8 textures
+    for (unsigned int bpp = 1; bpp <= 4; bpp *= 2) {
+        for (unsigned int width = 1; width <= 1024; width *= 2) {
+            for (unsigned int height = 1; height <= 1024; height *= 2) {
+                ok &= verify(width, height, bpp);
+            }
+        }
+    }
+    printf("Verification %s\n\n", (ok) ? "passed" : "FAILED");
+
+    printf("%-10s %4s %15s %15s %8s %15s %15s %8s\n", "size", "bpp", "swizzle old", "swizzle tiled", "speedup",
+           "unswizzle old", "unswizzle tiled", "speedup");
+    for (size_t b = 0; b < sizeof(bpps) / sizeof(bpps[0]); b++) {
+        const unsigned int bpp = bpps[b];
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            const unsigned int width = sizes[s].width;
+            const unsigned int height = sizes[s].height;
+            const unsigned int pitch = width * bpp;
+            uint8_t *linear = calloc(1, (size_t)pitch * height);
+            uint8_t *swizzled = calloc(1, (size_t)pitch * height);
+
+            const double swizzle_old = time_ns_per_pixel(baseline_swizzle, linear, width, height, swizzled, pitch, bpp);
+            const double swizzle_new = time_ns_per_pixel(tiled_swizzle, linear, width, height, swizzled, pitch, bpp);
+            const double unswizzle_old = time_ns_per_pixel(baseline_unswizzle, swizzled, width, height, linear, pitch, bpp);
+            const double unswizzle_new = time_ns_per_pixel(tiled_unswizzle, swizzled, width, height, linear, pitch, bpp);
+
+            char size_name[16];
+            snprintf(size_name, sizeof(size_name), "%ux%u", width, height);
+            printf("%-10s %4u %12.3f ns %12.3f ns %7.2fx %12.3f ns %12.3f ns %7.2fx\n", size_name, bpp,
+                   swizzle_old, swizzle_new, swizzle_old / swizzle_new,
+                   unswizzle_old, unswizzle_new, unswizzle_old / unswizzle_new);
+
+            free(linear);
+            free(swizzled);
+        }
+    }
+    printf("\nTimes are per pixel.\n");
+
+    return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}